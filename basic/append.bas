@@ -0,0 +1,23 @@
+10 REM
+20 REM BUILD A 1MB STRING ONE CHARACTER AT A TIME. APPENDING TO A
+30 REM VARIABLE'S OWN STRING IS DONE IN PLACE, SO THIS SHOULD TAKE
+40 REM LINEAR TIME; DOUBLING N SHOULD ROUGHLY DOUBLE THE RUN TIME.
+50 REM
+60 LET N% = 1048576
+70 LET A$ = ""
+80 FOR I% = 1 TO N%
+90 LET A$ = A$ + "*"
+100 NEXT I%
+110 LET B$ = ""
+120 FOR I% = 1 TO N% / 1024
+130 LET B$ = B$ + "*"
+140 NEXT I%
+150 LET C$ = ""
+160 FOR I% = 1 TO 1024
+170 LET C$ = C$ + B$
+180 NEXT I%
+190 IF A$ = C$ THEN 220
+200 PRINT "MISMATCH"
+210 GOTO 230
+220 PRINT "BUILT 1MB STRING"
+230 REM
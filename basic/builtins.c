@@ -7,108 +7,101 @@
 #include "runtime.h"
 #include "value.h"
 
-const int MAX_ARGS = 16;
-
-typedef struct builtin builtin;
-
-struct builtin
-{
-    const char *name;
-    value *(*execute)(runtime *rt, value **argv);
-    int args;
-    valuetype types[MAX_ARGS];
-};
-
-static value *builtin_abs(runtime *rt, value **argv);
-static value *builtin_cos(runtime *rt, value **argv);
-static value *builtin_ln(runtime *rt, value **argv);
-static value *builtin_log(runtime *rt, value **argv);
-static value *builtin_sin(runtime *rt, value **argv);
-static value *builtin_tab(runtime *rt, value **argv);
-static value *builtin_tan(runtime *rt, value **argv);
+static void builtin_abs(runtime *rt, value *argv, value *result);
+static void builtin_cos(runtime *rt, value *argv, value *result);
+static void builtin_ln(runtime *rt, value *argv, value *result);
+static void builtin_log(runtime *rt, value *argv, value *result);
+static void builtin_sin(runtime *rt, value *argv, value *result);
+static void builtin_tab(runtime *rt, value *argv, value *result);
+static void builtin_tan(runtime *rt, value *argv, value *result);
 
 static builtin builtins[] =
 {
-    { "ABS", &builtin_abs, 1, { TYPE_NUMBER } },
-    { "COS", &builtin_cos, 1, { TYPE_NUMBER } },
-    { "LN", &builtin_ln, 1, { TYPE_NUMBER } },
-    { "LOG", &builtin_log, 1, { TYPE_NUMBER } },
-    { "SIN", &builtin_sin, 1, { TYPE_NUMBER } },
-    { "TAB", &builtin_tab, 1, { TYPE_NUMBER } },
-    { "TAN", &builtin_tan, 1, { TYPE_NUMBER } },
-
-    { NULL, NULL, 0, {}}
+    { "ABS", BIFL_PURE, &builtin_abs, TYPE_NUMBER, 1, { TYPE_NUMBER } },
+    { "COS", BIFL_PURE, &builtin_cos, TYPE_NUMBER, 1, { TYPE_NUMBER } },
+    { "LN", BIFL_PURE, &builtin_ln, TYPE_NUMBER, 1, { TYPE_NUMBER } },
+    { "LOG", BIFL_PURE, &builtin_log, TYPE_NUMBER, 1, { TYPE_NUMBER } },
+    { "SIN", BIFL_PURE, &builtin_sin, TYPE_NUMBER, 1, { TYPE_NUMBER } },
+    { "TAB", 0, &builtin_tab, TYPE_VOID, 1, { TYPE_NUMBER } },
+    { "TAN", BIFL_PURE, &builtin_tan, TYPE_NUMBER, 1, { TYPE_NUMBER } },
+
+    { NULL, 0, NULL, TYPE_VOID, 0, {}}
 };
 
-/* Execute a built-in function
+/* Find a built-in function by name. This is done when the call is
+ * parsed; the caller is then responsible for passing exactly fn->args
+ * arguments. Returns NULL if there is no such function.
  */
-value *builtin_execute(runtime *rt, const char *id, int argc, value **argv)
+builtin *builtin_find(const char *name)
 {
-    int i = 0;
-    
-    for (i = 0; builtins[i].name != NULL; i++) {
-        if (strcasecmp(builtins[i].name, id) == 0) {
-            break;
+    for (builtin *fn = &builtins[0]; fn->name != NULL; fn++) {
+        if (strcasecmp(fn->name, name) == 0) {
+            return fn;
         }
     }
     
-    if (builtins[i].name == NULL) {
-        runtime_set_error(rt, "FUNCTION %s IS NOT DEFINED", id);
-        return NULL;
-    }
-    
-    return builtins[i].execute(rt, argv);
+    return NULL;
+}
+
+/* Execute a built-in function, storing its return value in result.
+ * The argument types were checked when the call was parsed.
+ * Returns 0 (with a runtime error set) on failure.
+ */
+int builtin_execute(runtime *rt, builtin *fn, value *argv, value *result)
+{
+    fn->execute(rt, argv, result);
+    return 1;
 }
 
 /* Absolute value
  */
-value *builtin_abs(runtime *rt, value **argv)
+void builtin_abs(runtime *rt, value *argv, value *result)
 {
-    return value_alloc_number(fabs(argv[0]->number));
+    value_set_number(result, fabs(argv[0].number));
 }
 
 /* Cosine
  */
-value *builtin_cos(runtime *rt, value **argv)
+void builtin_cos(runtime *rt, value *argv, value *result)
 {
-    return value_alloc_number(cos(argv[0]->number));
+    value_set_number(result, cos(argv[0].number));
 }
 
 /* Log base e
  */
-value *builtin_ln(runtime *rt, value **argv)
+void builtin_ln(runtime *rt, value *argv, value *result)
 {
-    return value_alloc_number(log(argv[0]->number));
+    value_set_number(result, log(argv[0].number));
 }
 
 /* Log base 10
  */
-value *builtin_log(runtime *rt, value **argv)
+void builtin_log(runtime *rt, value *argv, value *result)
 {
-    return value_alloc_number(log10(argv[0]->number));
+    value_set_number(result, log10(argv[0].number));
 }
 
 /* Sine
  */
-value *builtin_sin(runtime *rt, value **argv)
+void builtin_sin(runtime *rt, value *argv, value *result)
 {
-    return value_alloc_number(sin(argv[0]->number));
+    value_set_number(result, sin(argv[0].number));
 }
 
 /* tab to given position
  */
-value *builtin_tab(runtime *rt, value **argv)
+void builtin_tab(runtime *rt, value *argv, value *result)
 {
-    int col = (int)argv[0]->number;
+    int col = (int)argv[0].number;
     output *out = runtime_get_output(rt);
     output_tab_to_col(out, col);
-    return value_alloc_void();
+    value_set_void(result);
 }
 
 
 /* Tangent
  */
-value *builtin_tan(runtime *rt, value **argv)
+void builtin_tan(runtime *rt, value *argv, value *result)
 {
-    return value_alloc_number(tan(argv[0]->number));
+    value_set_number(result, tan(argv[0].number));
 }
@@ -1,9 +1,26 @@
 #ifndef builtins_h
 #define builtins_h
 
+#include "value.h"
+
+#define BUILTIN_MAX_ARGS 16
+
+#define BIFL_PURE 0x01          /* no side effects; may be computed when parsed */
+
+typedef struct builtin builtin;
 typedef struct runtime runtime;
-typedef struct value value;
 
-extern value *builtin_execute(runtime *rt, const char *id, int argc, value **argv);
+struct builtin
+{
+    const char *name;
+    unsigned flags;
+    void (*execute)(runtime *rt, value *argv, value *result);
+    valuetype result;
+    int args;
+    valuetype types[BUILTIN_MAX_ARGS];
+};
+
+extern builtin *builtin_find(const char *name);
+extern int builtin_execute(runtime *rt, builtin *fn, value *argv, value *result);
 
 #endif /* builtins_h */
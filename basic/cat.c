@@ -20,15 +20,13 @@ struct cat_node
 };
 
 static void cat_execute(statement_body *body, runtime *rt);
-static void cat_free(statement_body *body);
 
 /* Parse the cat statement
  */
 void cat_parse(parser *prs, statement *stmt)
 {
-    cat_node *cat = safe_calloc(1, sizeof(cat_node));
+    cat_node *cat = parser_alloc_node(prs, sizeof(cat_node));
     
-    cat->body.free = &cat_free;
     cat->body.execute = &cat_execute;
 
     stmt->body = &cat->body;
@@ -86,14 +84,7 @@ void cat_execute(statement_body *body, runtime *rt)
     if (col != 0) {
         output_print(out, "\n");
     }
-    
-}
 
-/* free a cat node
- */
-void cat_free(statement_body *body)
-{
-    free(body);
 }
 
 
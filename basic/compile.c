@@ -0,0 +1,324 @@
+#include <assert.h>
+
+#include "builtins.h"
+#include "compile.h"
+#include "program.h"
+#include "safemem.h"
+#include "statement.h"
+
+typedef struct open_loop open_loop;
+
+struct compiler
+{
+    bytecode *bc;
+    int depth;
+
+    int *fixups;
+    int used_fixups;
+    int allocated_fixups;
+
+    open_loop *loops;       /* FOR loops not yet paired with a NEXT */
+    int used_loops;
+    int allocated_loops;
+};
+
+struct open_loop
+{
+    int slot;
+    int body_pc;
+};
+
+static instr *compiler_append(compiler *cmp, opcode op);
+static int stack_effect(instr *ins);
+static void compile_statement(compiler *cmp, statement *stmt);
+static void link_program(compiler *cmp);
+
+/* Compile a whole program, which must have been linked without errors.
+ * The returned bytecode refers to data owned by the parsed statements,
+ * so it must be thrown away when the program changes.
+ */
+bytecode *compile_program(program *pgm)
+{
+    compiler cmp = { 0 };
+
+    cmp.bc = safe_calloc(1, sizeof(bytecode));
+
+    for (statement *p = pgm->head; p; p = p->next) {
+        compile_statement(&cmp, p);
+    }
+    compiler_emit(&cmp, OP_END);
+
+    link_program(&cmp);
+
+    free(cmp.fixups);
+    free(cmp.loops);
+
+    return cmp.bc;
+}
+
+/* Free compiled code
+ */
+void bytecode_free(bytecode *bc)
+{
+    if (bc) {
+        free(bc->code);
+    }
+    free(bc);
+}
+
+/* Turn profiling of compiled code on or off. Statement markers are
+ * swapped for ones which update the profile, so that code which isn't
+ * being profiled doesn't pay for it.
+ */
+void bytecode_set_profiling(bytecode *bc, int profile)
+{
+    opcode from = profile ? OP_STMT : OP_PROFILE_STMT;
+    opcode to = profile ? OP_PROFILE_STMT : OP_STMT;
+    
+    for (int i = 0; i < bc->used; i++) {
+        if (bc->code[i].op == from) {
+            bc->code[i].op = to;
+        }
+    }
+}
+
+/* Emit an instruction with no operands
+ */
+void compiler_emit(compiler *cmp, opcode op)
+{
+    compiler_append(cmp, op);
+}
+
+/* Emit a push of a number literal
+ */
+void compiler_emit_number(compiler *cmp, double number)
+{
+    compiler_append(cmp, OP_PUSH_NUM)->u.number = number;
+}
+
+/* Emit a push of an integer literal
+ */
+void compiler_emit_integer(compiler *cmp, int64_t integer)
+{
+    compiler_append(cmp, OP_PUSH_INT)->u.integer = integer;
+}
+
+/* Emit a push of a string literal. The literal keeps the string
+ * alive, so the instruction doesn't take a reference.
+ */
+void compiler_emit_string(compiler *cmp, strobj *string)
+{
+    compiler_append(cmp, OP_PUSH_STR)->u.str = string;
+}
+
+/* Emit an instruction which acts on a variable. The name is kept for
+ * error messages and is not copied.
+ */
+void compiler_emit_var(compiler *cmp, opcode op, int slot, const char *name)
+{
+    instr *ins = compiler_append(cmp, op);
+    ins->arg = slot;
+    ins->u.string = name;
+}
+
+/* Emit a call to a builtin function with its arguments already on
+ * the stack
+ */
+void compiler_emit_call(compiler *cmp, builtin *fn)
+{
+    instr *ins = compiler_append(cmp, OP_CALL);
+    ins->u.fn = fn;
+    ins->arg = fn->args;
+    cmp->depth += 1 - fn->args;
+}
+
+/* Emit a binary operator. token is the operator's token type, which
+ * string comparisons use to pick the relation.
+ */
+void compiler_emit_binop(compiler *cmp, opcode op, int token)
+{
+    compiler_append(cmp, op)->arg = token;
+}
+
+/* Emit a transfer to a statement. The target's code offset is filled
+ * in once the whole program has been compiled.
+ */
+void compiler_emit_goto(compiler *cmp, opcode op, statement *target)
+{
+    assert(op == OP_GOTO || op == OP_GOSUB);
+    assert(target != NULL);
+
+    compiler_append(cmp, op)->u.stmt = target;
+
+    if (cmp->used_fixups == cmp->allocated_fixups) {
+        cmp->allocated_fixups = cmp->allocated_fixups ? 2 * cmp->allocated_fixups : 16;
+        cmp->fixups = safe_realloc(cmp->fixups, cmp->allocated_fixups * sizeof(cmp->fixups[0]));
+    }
+    cmp->fixups[cmp->used_fixups++] = cmp->bc->used - 1;
+}
+
+/* Emit a NEXT which has been paired with its FOR. target is the code
+ * offset of the loop body.
+ */
+void compiler_emit_next(compiler *cmp, opcode op, int slot, int target)
+{
+    assert(op == OP_NEXT_NUM || op == OP_NEXT_INT);
+
+    instr *ins = compiler_append(cmp, op);
+    ins->arg = slot;
+    ins->u.target = target;
+}
+
+/* Note a FOR loop on slot whose body starts at the next instruction
+ * to be emitted, for a later NEXT to pair with
+ */
+void compiler_open_loop(compiler *cmp, int slot)
+{
+    if (cmp->used_loops == cmp->allocated_loops) {
+        cmp->allocated_loops = cmp->allocated_loops ? 2 * cmp->allocated_loops : 16;
+        cmp->loops = safe_realloc(cmp->loops, cmp->allocated_loops * sizeof(open_loop));
+    }
+
+    open_loop *loop = &cmp->loops[cmp->used_loops++];
+    loop->slot = slot;
+    loop->body_pc = cmp->bc->used;
+}
+
+/* Pair a NEXT on slot (or -1 for any loop) with the innermost FOR
+ * above it which hasn't been paired yet. This follows the program's
+ * text, not how it runs, so the pairing must be checked at runtime.
+ * Returns the loop's slot and sets body_pc, or returns -1 if the NEXT
+ * doesn't match.
+ */
+int compiler_close_loop(compiler *cmp, int slot, int *body_pc)
+{
+    if (cmp->used_loops == 0) {
+        return -1;
+    }
+
+    open_loop *loop = &cmp->loops[cmp->used_loops - 1];
+    if (slot != -1 && loop->slot != slot) {
+        return -1;
+    }
+
+    cmp->used_loops--;
+    *body_pc = loop->body_pc;
+    return loop->slot;
+}
+
+/* Emit a forward branch within a statement. Returns a handle to pass
+ * to compiler_patch_branch once the target has been reached.
+ */
+int compiler_emit_branch(compiler *cmp, opcode op)
+{
+    assert(op == OP_JUMP || op == OP_JUMP_FALSE);
+
+    compiler_append(cmp, op)->u.target = -1;
+    return cmp->bc->used - 1;
+}
+
+/* Point a branch at the next instruction to be emitted
+ */
+void compiler_patch_branch(compiler *cmp, int branch)
+{
+    cmp->bc->code[branch].u.target = cmp->bc->used;
+}
+
+/* Append an instruction to the code and track how deep the value
+ * stack can get
+ */
+instr *compiler_append(compiler *cmp, opcode op)
+{
+    bytecode *bc = cmp->bc;
+
+    if (bc->used == bc->allocated) {
+        bc->allocated = bc->allocated ? 2 * bc->allocated : 256;
+        bc->code = safe_realloc(bc->code, bc->allocated * sizeof(instr));
+    }
+
+    instr *ins = &bc->code[bc->used++];
+    ins->op = op;
+    ins->arg = 0;
+    ins->u.target = 0;
+
+    cmp->depth += stack_effect(ins);
+    assert(cmp->depth >= 0);
+    if (cmp->depth > bc->max_stack) {
+        bc->max_stack = cmp->depth;
+    }
+
+    return ins;
+}
+
+/* Returns the change in the value stack depth caused by an instruction
+ * (OP_CALL is accounted for by its emitter since it depends on the
+ * argument count)
+ */
+int stack_effect(instr *ins)
+{
+    switch (ins->op) {
+    case OP_PUSH_NUM:
+    case OP_PUSH_INT:
+    case OP_PUSH_STR:
+    case OP_LOAD:
+        return 1;
+
+    case OP_STORE:
+    case OP_APPEND:
+    case OP_ADD:
+    case OP_SUB:
+    case OP_MUL:
+    case OP_DIV:
+    case OP_LT:
+    case OP_GT:
+    case OP_LE:
+    case OP_GE:
+    case OP_EQ:
+    case OP_NE:
+    case OP_ADD_INT:
+    case OP_SUB_INT:
+    case OP_MUL_INT:
+    case OP_COMPARE_INT:
+    case OP_CONCAT:
+    case OP_COMPARE_STRINGS:
+    case OP_PRINT:
+    case OP_JUMP_FALSE:
+        return -1;
+
+    case OP_FOR:
+        return -3;
+
+    default:
+        break;
+    }
+
+    return 0;
+}
+
+/* Compile one statement. Statements which don't know how to compile
+ * themselves are handed back to the tree walker at runtime.
+ */
+void compile_statement(compiler *cmp, statement *stmt)
+{
+    stmt->pc = cmp->bc->used;
+    compiler_append(cmp, OP_STMT)->u.stmt = stmt;
+
+    if (stmt->body->compile) {
+        stmt->body->compile(stmt->body, cmp);
+    } else {
+        compiler_append(cmp, OP_EXEC)->u.body = stmt->body;
+    }
+
+    /* every statement leaves the stack empty */
+    assert(cmp->depth == 0);
+}
+
+/* Resolve target statements to code offsets
+ */
+void link_program(compiler *cmp)
+{
+    for (int i = 0; i < cmp->used_fixups; i++) {
+        instr *ins = &cmp->bc->code[cmp->fixups[i]];
+        ins->u.target = ins->u.stmt->pc;
+    }
+}
@@ -0,0 +1,115 @@
+#ifndef compile_h
+#define compile_h
+
+#include <stdint.h>
+
+/* The compiler lowers a parsed program into a flat array of instructions
+ * for the VM. Each statement starts with an OP_STMT marker, followed by
+ * code which evaluates expressions on a value stack and then acts on the
+ * results.
+ */
+
+typedef struct builtin builtin;
+typedef struct bytecode bytecode;
+typedef struct compiler compiler;
+typedef struct instr instr;
+typedef enum opcode opcode;
+typedef struct program program;
+typedef struct statement statement;
+typedef struct statement_body statement_body;
+typedef struct strobj strobj;
+
+enum opcode
+{
+    OP_STMT,            /* start of statement u.stmt */
+    OP_PROFILE_STMT,    /* OP_STMT, while the profiler is on */
+    OP_EXEC,            /* run u.body through the tree walker */
+    OP_END,             /* end of program */
+
+    OP_PUSH_NUM,        /* push u.number */
+    OP_PUSH_INT,        /* push u.integer */
+    OP_PUSH_STR,        /* push a reference to u.str */
+    OP_LOAD,            /* push a copy of variable slot arg, named u.string */
+    OP_STORE,           /* pop into variable slot arg, named u.string */
+    OP_APPEND,          /* pop a string and append it to variable slot arg */
+    OP_CALL,            /* call builtin u.fn with its arguments on the stack */
+
+    OP_ADD,             /* binary operators on numbers */
+    OP_SUB,
+    OP_MUL,
+    OP_DIV,
+    OP_LT,
+    OP_GT,
+    OP_LE,
+    OP_GE,
+    OP_EQ,
+    OP_NE,
+    OP_NEG,
+    OP_ADD_INT,         /* binary operators on integers */
+    OP_SUB_INT,
+    OP_MUL_INT,
+    OP_COMPARE_INT,     /* compare two integers; arg holds the relop token */
+    OP_NEG_INT,
+    OP_TO_NUMBER,       /* convert an integer to a number */
+    OP_TO_INTEGER,      /* truncate a number to an integer */
+    OP_CONCAT,          /* join two strings */
+    OP_COMPARE_STRINGS, /* compare two strings; arg holds the relop token */
+
+    OP_PRINT,           /* pop and print */
+    OP_PRINT_TAB,       /* advance to the next print zone */
+    OP_PRINT_NL,        /* end the printed line */
+
+    OP_JUMP,            /* jump to u.target */
+    OP_JUMP_FALSE,      /* pop a boolean and jump to u.target if false */
+    OP_GOTO,            /* jump to statement u.stmt, linked to u.target */
+    OP_GOSUB,           /* call statement u.stmt, linked to u.target */
+    OP_RETURN,
+    OP_FOR,             /* pop limit, step and start for loop index slot arg */
+    OP_NEXT,            /* next iteration of loop index slot arg (may be -1) */
+    OP_NEXT_NUM,        /* next iteration of the loop on slot arg whose body */
+    OP_NEXT_INT,        /* is at u.target, else fall through to OP_NEXT */
+};
+
+struct instr
+{
+    opcode op;
+    int arg;
+    union {
+        double number;
+        int64_t integer;
+        const char *string;
+        strobj *str;
+        statement *stmt;
+        statement_body *body;
+        builtin *fn;
+        int target;
+    } u;
+};
+
+struct bytecode
+{
+    instr *code;
+    int used;
+    int allocated;
+    int max_stack;
+};
+
+extern bytecode *compile_program(program *pgm);
+extern void bytecode_free(bytecode *bc);
+extern void bytecode_set_profiling(bytecode *bc, int profile);
+
+extern void compiler_emit(compiler *cmp, opcode op);
+extern void compiler_emit_number(compiler *cmp, double number);
+extern void compiler_emit_integer(compiler *cmp, int64_t integer);
+extern void compiler_emit_string(compiler *cmp, strobj *string);
+extern void compiler_emit_var(compiler *cmp, opcode op, int slot, const char *name);
+extern void compiler_emit_call(compiler *cmp, builtin *fn);
+extern void compiler_emit_binop(compiler *cmp, opcode op, int token);
+extern void compiler_emit_goto(compiler *cmp, opcode op, statement *target);
+extern void compiler_emit_next(compiler *cmp, opcode op, int slot, int target);
+extern void compiler_open_loop(compiler *cmp, int slot);
+extern int compiler_close_loop(compiler *cmp, int slot, int *body_pc);
+extern int compiler_emit_branch(compiler *cmp, opcode op);
+extern void compiler_patch_branch(compiler *cmp, int branch);
+
+#endif /* compile_h */
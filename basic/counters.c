@@ -0,0 +1,66 @@
+#include <inttypes.h>
+#include <stddef.h>
+
+#include "counters.h"
+#include "output.h"
+
+counters basic_counters;
+
+typedef struct counter_field counter_field;
+
+struct counter_field
+{
+    const char *name;
+    size_t offset;
+};
+
+static counter_field fields[] =
+{
+    { "statements", offsetof(counters, statements) },
+    { "jumps", offsetof(counters, jumps) },
+    { "vm_jumps", offsetof(counters, vm_jumps) },
+    { "scope_pushes", offsetof(counters, scope_pushes) },
+    { "scope_pops", offsetof(counters, scope_pops) },
+    { "value_allocs", offsetof(counters, value_allocs) },
+    { "value_copies", offsetof(counters, value_copies) },
+    { "heap_allocs", offsetof(counters, heap_allocs) },
+    { "heap_bytes", offsetof(counters, heap_bytes) },
+    { "output_bytes", offsetof(counters, output_bytes) },
+
+    { NULL, 0 }
+};
+
+static uint64_t field_value(counters *cnt, counter_field *field);
+
+/* Print the counters, one per line. They're read before anything is
+ * printed so that the output doesn't count itself.
+ */
+void counters_print(output *out)
+{
+    counters snapshot = basic_counters;
+    
+    for (counter_field *field = &fields[0]; field->name != NULL; field++) {
+        output_print(out, "%-14s %" PRIu64 "\n", field->name, field_value(&snapshot, field));
+    }
+}
+
+/* Print the counters as a single JSON object
+ */
+void counters_print_json(FILE *fp)
+{
+    const char *sep = "";
+    
+    fputc('{', fp);
+    for (counter_field *field = &fields[0]; field->name != NULL; field++) {
+        fprintf(fp, "%s\"%s\":%" PRIu64, sep, field->name, field_value(&basic_counters, field));
+        sep = ",";
+    }
+    fputs("}\n", fp);
+}
+
+/* Returns the value of one counter
+ */
+uint64_t field_value(counters *cnt, counter_field *field)
+{
+    return *(uint64_t *)((char *)cnt + field->offset);
+}
@@ -0,0 +1,34 @@
+#ifndef counters_h
+#define counters_h
+
+#include <stdint.h>
+#include <stdio.h>
+
+/* Counters of what the interpreter has done since it started. They're
+ * always on, so each one must be no more than an increment in the code
+ * path it counts.
+ */
+
+typedef struct counters counters;
+typedef struct output output;
+
+struct counters
+{
+    uint64_t statements;        /* statements executed, by either engine */
+    uint64_t jumps;             /* runtime_set_next_statement calls */
+    uint64_t vm_jumps;          /* jumps between statements in compiled code */
+    uint64_t scope_pushes;
+    uint64_t scope_pops;
+    uint64_t value_allocs;      /* values allocated on the heap */
+    uint64_t value_copies;
+    uint64_t heap_allocs;       /* calls through safemem */
+    uint64_t heap_bytes;        /* bytes requested through safemem */
+    uint64_t output_bytes;      /* bytes written by the output stream */
+};
+
+extern counters basic_counters;
+
+extern void counters_print(output *out);
+extern void counters_print_json(FILE *fp);
+
+#endif /* counters_h */
@@ -1,30 +1,91 @@
 #include <assert.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "builtins.h"
+#include "compile.h"
 #include "expression.h"
+#include "numformat.h"
+#include "numparse.h"
 #include "parser.h"
 #include "runtime.h"
 #include "safemem.h"
 #include "stringutil.h"
+#include "strobj.h"
 #include "value.h"
+#include "vartable.h"
+
+/* Values the flat form of an expression can have on its stack at once.
+ * Deeper expressions are evaluated by walking the tree.
+ */
+#define EXPRESSION_STACK_SIZE 32
 
 typedef struct binop binop;
-typedef struct binop_argtypes binop_argtypes;
+typedef struct binop_type binop_type;
+typedef enum cellop cellop;
+typedef struct expcell expcell;
 typedef struct funarg funarg;
 typedef struct funop funop;
 typedef struct litop litop;
 typedef struct unop unop;
 typedef struct varref varref;
 
+/* The flat form of an expression is an array of cells in postfix
+ * order. Each cell pops its operands from a value stack and pushes its
+ * result.
+ */
+enum cellop
+{
+    CELL_LITERAL,           /* push u.literal */
+    CELL_VAR,               /* push variable slot arg, named u.name */
+    CELL_CALL,              /* call u.fn with its arg arguments */
+    CELL_ADD,               /* binary operators on numbers */
+    CELL_SUBTRACT,
+    CELL_MULTIPLY,
+    CELL_DIVIDE,
+    CELL_COMPARE,           /* arg holds the relop token */
+    CELL_INTEGER_ARITHMETIC,/* arg holds the operator token */
+    CELL_COMPARE_INTEGERS,
+    CELL_STRINGS,           /* concatenate or compare, by arg */
+    CELL_NEGATE,
+    CELL_NEGATE_INTEGER,
+    CELL_TO_NUMBER,
+    CELL_TO_INTEGER,
+};
+
+struct expcell
+{
+    cellop op;
+    int arg;
+    union {
+        value literal;      /* borrowed from the literal node */
+        const char *name;
+        builtin *fn;
+    } u;
+};
+
+struct lowering
+{
+    expcell *cells;
+    int used;
+    int allocated;
+    int depth;              /* values on the stack after the cells so far */
+    int max_depth;
+};
+
 struct expression
 {
     expopnode *root;
+    arena *nodes;
+    expcell *cells;         /* NULL if the stack would be too deep */
+    int count;
 };
 
 struct binop
 {
     expopnode opnode;
+    token_type op;
+    cellop cell;
     expopnode *left;
     expopnode *right;
 };
@@ -32,7 +93,9 @@ struct binop
 struct litop
 {
     expopnode opnode;
-    value *literal;
+    value literal;
+    int exact;          /* a number written as a whole number, which
+                         * literal.integer holds exactly */
 };
 
 struct unop
@@ -51,6 +114,7 @@ struct funop
 {
     expopnode opnode;
     char *name;
+    builtin *fn;
     int args;
     funarg *arglist;
 };
@@ -59,21 +123,29 @@ struct varref
 {
     expopnode opnode;
     char *varname;
+    int slot;
 };
 
-static int binop_validate(const char *op, valuetype left, valuetype right, binop_argtypes *valid, runtime *rt);
-static value *eval_less(expopnode *node, runtime *rt);
-static value *eval_greater(expopnode *node, runtime *rt);
-static value *eval_lesseq(expopnode *node, runtime *rt);
-static value *eval_greatereq(expopnode *node, runtime *rt);
-static value *eval_equal(expopnode *node, runtime *rt);
-static value *eval_notequal(expopnode *node, runtime *rt);
-static value *eval_plus(expopnode *node, runtime *rt);
-static value *eval_minus(expopnode *node, runtime *rt);
-static value *eval_times(expopnode *node, runtime *rt);
-static value *eval_divide(expopnode *node, runtime *rt);
-static value *eval_unary_minus(expopnode *node, runtime *rt);
+static int eval_add_numbers(expopnode *node, runtime *rt, value *result);
+static int eval_subtract_numbers(expopnode *node, runtime *rt, value *result);
+static int eval_multiply_numbers(expopnode *node, runtime *rt, value *result);
+static int eval_divide_numbers(expopnode *node, runtime *rt, value *result);
+static int eval_compare_numbers(expopnode *node, runtime *rt, value *result);
+static int eval_integer_arithmetic(expopnode *node, runtime *rt, value *result);
+static int eval_compare_integers(expopnode *node, runtime *rt, value *result);
+static int integer_arithmetic(token_type op, int64_t left, int64_t right, int64_t *result);
+static int eval_concat_strings(expopnode *node, runtime *rt, value *result);
+static int eval_compare_strings(expopnode *node, runtime *rt, value *result);
+static int eval_operands(binop *bop, runtime *rt, value *left, value *right);
+static int compare(token_type op, double left, double right);
+static binop_type *find_binop_type(token_type op, valuetype left, valuetype right);
+static const char *describe_binop(token_type op);
+static int eval_unary_minus(expopnode *node, runtime *rt, value *result);
+static int eval_negate_integer(expopnode *node, runtime *rt, value *result);
+static int eval_to_number(expopnode *node, runtime *rt, value *result);
+static int eval_to_integer(expopnode *node, runtime *rt, value *result);
 
+static expression *parse_subexpression(parser *prs);
 static expopnode *parse_expression(parser *prs);
 static expopnode *parse_relop_term(parser *prs);
 static expopnode *parse_sum_term(parser *prs);
@@ -83,24 +155,64 @@ static expopnode *parse_paren_term(parser *prs);
 static expopnode *parse_function_call(parser *prs, char *fn_name);
 
 static void free_binop(expopnode *node);
-static expopnode *alloc_binop(token_type op, expopnode *left, expopnode *right);
+static void compile_binop(expopnode *node, compiler *cmp);
+static void lower_binop(expopnode *node, lowering *low);
+static expopnode *fold_binop(expopnode *node, arena *nodes);
+static expopnode *unwrap_binop(binop *bop, expopnode **keep);
+static void dump_binop(expopnode *node, FILE *fp);
+static expopnode *alloc_binop(parser *prs, token_type op, expopnode *left, expopnode *right);
 static void free_unop(expopnode *node);
-static expopnode *alloc_unop(token_type op, expopnode *value);
+static void compile_unop(expopnode *node, compiler *cmp);
+static void lower_unop(expopnode *node, lowering *low);
+static expopnode *fold_unop(expopnode *node, arena *nodes);
+static void dump_unop(expopnode *node, FILE *fp);
+static expopnode *alloc_unop(parser *prs, token_type op, expopnode *value);
+static void compile_convert(expopnode *node, compiler *cmp);
+static void lower_convert(expopnode *node, lowering *low);
+static expopnode *fold_convert(expopnode *node, arena *nodes);
+static void dump_convert(expopnode *node, FILE *fp);
+static expopnode *alloc_convert(arena *nodes, expopnode *value, valuetype type);
+static expopnode *convert(arena *nodes, expopnode *node, valuetype type);
+static expopnode *promote(arena *nodes, expopnode *node, valuetype type);
 
-static value *eval_literal(expopnode *node, runtime *rt);
+static int eval_literal(expopnode *node, runtime *rt, value *result);
 static void free_litop(expopnode *node);
-static expopnode *alloc_literal(value *value);
+static void compile_litop(expopnode *node, compiler *cmp);
+static void lower_litop(expopnode *node, lowering *low);
+static void dump_litop(expopnode *node, FILE *fp);
+static expopnode *alloc_literal(arena *nodes, value *val);
+static value *literal_value(expopnode *node);
+static int is_literal_number(expopnode *node, double number);
+static void integral_literal(expopnode *node, valuetype type);
+static int is_arithmetic(expopnode *node);
+static expopnode *parse_number_literal(parser *prs);
 
-static value *eval_varref(expopnode *node, runtime *rt);
-static void free_varref(expopnode *node);
-static expopnode *alloc_varref(char *varname);
+static int eval_varref(expopnode *node, runtime *rt, value *result);
+static void compile_varref(expopnode *node, compiler *cmp);
+static void lower_varref(expopnode *node, lowering *low);
+static void dump_varref(expopnode *node, FILE *fp);
+static expopnode *alloc_varref(arena *nodes, char *varname);
 
-static void cleanup_funargs(int argc, value **argv);
-static value *eval_function(expopnode *node, runtime *rt);
+static void lower_expression(expression *exp);
+static expcell *emit_cell(lowering *low, cellop op, int arg, int pops);
+static int eval_cells(expression *exp, runtime *rt, value *result);
+
+static void cleanup_funargs(int argc, value *argv);
+static int bind_function(parser *prs, funop *fun);
+static int eval_function(expopnode *node, runtime *rt, value *result);
 static void free_function(expopnode *node);
+static void compile_function(expopnode *node, compiler *cmp);
+static void lower_function(expopnode *node, lowering *low);
+static expopnode *fold_function(expopnode *node, arena *nodes);
+static void dump_function(expopnode *node, FILE *fp);
+
+static void free_none(expopnode *node);
+static expopnode *fold_none(expopnode *node, arena *nodes);
 
 
-/* top level expression parser
+/* top level expression parser. Once parsed, any parts of the
+ * expression which are constant are computed, and the tree is lowered
+ * to the flat form which is evaluated.
  *
  * precedence
  * highest  A  *|/  B
@@ -109,32 +221,280 @@ static void free_function(expopnode *node);
  */
 expression *expression_parse(parser *prs)
 {
-    expression *exp = safe_calloc(1, sizeof(expression));
+    expression *exp = parse_subexpression(prs);
+    if (exp == NULL) {
+        return NULL;
+    }
     
-    exp->root = parse_expression(prs);
-    if (exp->root == NULL) {
-        free(exp);
-        exp = NULL;
+    if (prs->dump_folding) {
+        fprintf(stderr, "EXPRESSION ");
+        exp->root->dump(exp->root, stderr);
+        fprintf(stderr, "\n");
+    }
+    
+    exp->root = exp->root->fold(exp->root, exp->nodes);
+    
+    if (prs->dump_folding) {
+        fprintf(stderr, "FOLDED     ");
+        exp->root->dump(exp->root, stderr);
+        fprintf(stderr, "\n");
     }
     
+    lower_expression(exp);
     return exp;
 }
 
-/* Free an expression tree
+/* Parse an expression which is part of a larger one, and so will be
+ * folded along with it
+ */
+expression *parse_subexpression(parser *prs)
+{
+    expression *exp = parser_alloc_node(prs, sizeof(expression));
+    
+    exp->nodes = prs->nodes;
+    exp->root = parse_expression(prs);
+    
+    return exp->root ? exp : NULL;
+}
+
+/* Release what an expression tree holds outside of its arena
  */
 void expression_free(expression *exp)
 {
     if (exp && exp->root) {
         exp->root->free(exp->root);
     }
-    free(exp);
 }
 
 /* Evaluate an expression
  */
-value *expression_evaluate(expression *exp, runtime *rt)
+int expression_evaluate(expression *exp, runtime *rt, value *result)
+{
+    if (exp->cells) {
+        return eval_cells(exp, rt, result);
+    }
+    return exp->root->evaluate(exp->root, rt, result);
+}
+
+/* Returns the type of value the expression produces
+ */
+valuetype expression_type(expression *exp)
 {
-    return exp->root->evaluate(exp->root, rt);
+    return exp->root->type;
+}
+
+/* Make an expression produce type, as when it's assigned to a variable
+ * of that type. Integers and numbers convert to each other; numbers are
+ * truncated towards zero. Returns 0 if that isn't possible, else 1.
+ */
+int expression_convert(expression *exp, valuetype type)
+{
+    expopnode *node = convert(exp->nodes, exp->root, type);
+    if (node == NULL) {
+        return 0;
+    }
+    
+    if (node != exp->root) {
+        exp->root = node->fold(node, exp->nodes);
+        lower_expression(exp);
+    }
+    return 1;
+}
+
+/* If exp starts by concatenating the string variable in slot with
+ * something (A$ + ...), remove the variable so that exp evaluates to
+ * just what is appended to it, and return 1. Otherwise return 0 and
+ * leave exp alone.
+ */
+int expression_strip_append(expression *exp, int slot)
+{
+    /* the variable is the leftmost operand of a chain of
+     * concatenations, ((A$ + X$) + Y$)
+     */
+    expopnode **link = NULL;
+    expopnode **leftmost = &exp->root;
+    while ((*leftmost)->evaluate == &eval_concat_strings) {
+        link = leftmost;
+        leftmost = &((binop *)*leftmost)->left;
+    }
+    
+    if (link == NULL || (*leftmost)->evaluate != &eval_varref || ((varref *)*leftmost)->slot != slot) {
+        return 0;
+    }
+    
+    binop *bop = (binop *)*link;
+    *link = bop->right;
+    bop->right = NULL;
+    free_binop(&bop->opnode);
+    
+    /* the rest may now be constant, as in A$ + "X" + "Y" */
+    exp->root = exp->root->fold(exp->root, exp->nodes);
+    lower_expression(exp);
+    return 1;
+}
+
+/* Emit code which leaves the value of the expression on top of
+ * the VM stack
+ */
+void expression_compile(expression *exp, compiler *cmp)
+{
+    exp->root->compile(exp->root, cmp);
+}
+
+/* Lower the tree to the flat form, unless it needs a deeper stack than
+ * the flat evaluator has, in which case the tree is evaluated instead
+ */
+void lower_expression(expression *exp)
+{
+    lowering low = { NULL, 0, 0, 0, 0 };
+    
+    exp->root->lower(exp->root, &low);
+    
+    exp->cells = NULL;
+    exp->count = 0;
+    if (low.max_depth <= EXPRESSION_STACK_SIZE) {
+        exp->cells = arena_calloc(exp->nodes, low.used, sizeof(expcell));
+        memcpy(exp->cells, low.cells, low.used * sizeof(expcell));
+        exp->count = low.used;
+    }
+    
+    free(low.cells);
+}
+
+/* Append a cell which pops pops values and pushes its result
+ */
+expcell *emit_cell(lowering *low, cellop op, int arg, int pops)
+{
+    if (low->used == low->allocated) {
+        low->allocated = low->allocated ? 2 * low->allocated : 16;
+        low->cells = safe_realloc(low->cells, low->allocated * sizeof(expcell));
+    }
+    
+    low->depth += 1 - pops;
+    if (low->depth > low->max_depth) {
+        low->max_depth = low->depth;
+    }
+    
+    expcell *cell = &low->cells[low->used++];
+    cell->op = op;
+    cell->arg = arg;
+    return cell;
+}
+
+/* Evaluate the flat form of an expression, keeping operands on a
+ * stack instead of recursing
+ */
+int eval_cells(expression *exp, runtime *rt, value *result)
+{
+    value stack[EXPRESSION_STACK_SIZE];
+    value *sp = stack;
+    vartable *vars = runtime_vars(rt);
+    value ret;
+    int order;
+    
+    for (expcell *cell = exp->cells, *end = cell + exp->count; cell < end; cell++) {
+        switch (cell->op) {
+        case CELL_LITERAL:
+            value_copy(sp++, &cell->u.literal);
+            break;
+        
+        case CELL_VAR:
+            if (!vartable_get(vars, cell->arg, sp)) {
+                runtime_set_error(rt, "VARIABLE %s IS NOT DEFINED", cell->u.name);
+                goto error;
+            }
+            sp++;
+            break;
+        
+        case CELL_CALL:
+            {
+                sp -= cell->arg;
+                int ok = builtin_execute(rt, cell->u.fn, sp, &ret);
+                cleanup_funargs(cell->arg, sp);
+                if (!ok) {
+                    goto error;
+                }
+                *sp++ = ret;
+            }
+            break;
+        
+        case CELL_ADD:
+            sp--;
+            sp[-1].number += sp->number;
+            break;
+        
+        case CELL_SUBTRACT:
+            sp--;
+            sp[-1].number -= sp->number;
+            break;
+        
+        case CELL_MULTIPLY:
+            sp--;
+            sp[-1].number *= sp->number;
+            break;
+        
+        case CELL_DIVIDE:
+            sp--;
+            sp[-1].number /= sp->number;
+            break;
+        
+        case CELL_COMPARE:
+            sp--;
+            value_set_boolean(&sp[-1], compare(cell->arg, sp[-1].number, sp->number));
+            break;
+        
+        case CELL_INTEGER_ARITHMETIC:
+            sp--;
+            if (!integer_arithmetic(cell->arg, sp[-1].integer, sp->integer, &sp[-1].integer)) {
+                runtime_set_error(rt, "INTEGER OVERFLOW");
+                goto error;
+            }
+            break;
+        
+        case CELL_COMPARE_INTEGERS:
+            sp--;
+            order = (sp[-1].integer > sp->integer) - (sp[-1].integer < sp->integer);
+            value_set_boolean(&sp[-1], compare(cell->arg, order, 0));
+            break;
+        
+        case CELL_STRINGS:
+            sp--;
+            expression_string_binop(cell->arg, &sp[-1], sp, &ret);
+            sp[-1] = ret;
+            break;
+        
+        case CELL_NEGATE:
+            sp[-1].number = -sp[-1].number;
+            break;
+        
+        case CELL_NEGATE_INTEGER:
+            if (sp[-1].integer == INT64_MIN) {
+                runtime_set_error(rt, "INTEGER OVERFLOW");
+                goto error;
+            }
+            sp[-1].integer = -sp[-1].integer;
+            break;
+        
+        case CELL_TO_NUMBER:
+            value_set_number(&sp[-1], (double)sp[-1].integer);
+            break;
+        
+        case CELL_TO_INTEGER:
+            if (!expression_number_to_integer(sp[-1].number, &sp[-1].integer)) {
+                runtime_set_error(rt, "INTEGER OVERFLOW");
+                goto error;
+            }
+            sp[-1].type = TYPE_INTEGER;
+            break;
+        }
+    }
+    
+    *result = stack[0];
+    return 1;
+
+error:
+    cleanup_funargs((int)(sp - stack), stack);
+    return 0;
 }
 
 /* Parse top level of expression
@@ -160,7 +520,7 @@ expopnode *parse_expression(parser *prs)
             return NULL;
         }
         
-        left = alloc_binop(op, left, right);
+        left = alloc_binop(prs, op, left, right);
     }
     
     return left;
@@ -185,7 +545,9 @@ expopnode *parse_relop_term(parser *prs)
             return NULL;
         }
         
-        left = alloc_binop(op, left, right);
+        if ((left = alloc_binop(prs, op, left, right)) == NULL) {
+            return NULL;
+        }
     }
     
     return left;
@@ -205,12 +567,14 @@ expopnode *parse_sum_term(parser *prs)
         token_type op = prs->token_type;
         parse_next_token(prs);
         
-        expopnode *right = parse_sum_term(prs);
+        expopnode *right = parse_mul_term(prs);
         if (right == NULL) {
             left->free(left);
             return NULL;
         }
-        left = alloc_binop(op, left, right);
+        if ((left = alloc_binop(prs, op, left, right)) == NULL) {
+            return NULL;
+        }
     }
     
     return left;
@@ -230,7 +594,7 @@ expopnode *parse_mul_term(parser *prs)
     expopnode *value = parse_unary_term(prs);
     
     if (value && negate) {
-        value = alloc_unop(TOK_MINUS, value);
+        value = alloc_unop(prs, TOK_MINUS, value);
     }
     
     return value;
@@ -267,34 +631,33 @@ expopnode *parse_paren_term(parser *prs)
 {
     expopnode *ret = NULL;
     char *text = NULL;
-    double num = 0;
     
     switch (prs->token_type) {
     case TOK_STRING:
-        text = parser_extract_token_text(prs);
-        strunquote(text);
-        ret = alloc_literal(value_alloc_string(text, VAL_ALLOCATED));
-        parse_next_token(prs);
+        {
+            value val;
+            
+            text = parser_extract_token_text(prs);
+            strunquote(text);
+            value_set_string(&val, strobj_intern(prs->strings, text, strlen(text)));
+            ret = alloc_literal(prs->nodes, &val);
+            free(text);
+            parse_next_token(prs);
+        }
         break;
         
     case TOK_NUMBER:
-        text = parser_extract_token_text(prs);
-        sscanf(text, "%lf", &num);
-        ret = alloc_literal(value_alloc_number(num));
-        free(text);
-        parse_next_token(prs);
+        ret = parse_number_literal(prs);
         break;
         
     case TOK_IDENTIFIER:
-        text = parser_extract_token_text(prs);
+        text = parser_keep_token_text(prs);
         parse_next_token(prs);
         if (prs->token_type == TOK_LPAREN) {
             ret = parse_function_call(prs, text);
         } else {
-            ret = alloc_varref(text);
+            ret = alloc_varref(prs->nodes, text);
         }
-        /* do not free(text) - it's owned by either the function call or the varref 
-         */
         break;
     
     default:
@@ -315,13 +678,21 @@ expopnode *parse_function_call(parser *prs, char *fn_name)
         return NULL;
     }
     
-    funop *fun = safe_calloc(1, sizeof(funop));
+    funop *fun = parser_alloc_node(prs, sizeof(funop));
     fun->name = fn_name;
     fun->opnode.evaluate = &eval_function;
     fun->opnode.free = &free_function;
+    fun->opnode.compile = &compile_function;
+    fun->opnode.lower = &lower_function;
+    fun->opnode.fold = &fold_function;
+    fun->opnode.dump = &dump_function;
 
     if (prs->token_type == TOK_RPAREN) {
         parse_next_token(prs);
+        if (!bind_function(prs, fun)) {
+            free_function(&fun->opnode);
+            return NULL;
+        }
         return &fun->opnode;
     }
 
@@ -329,14 +700,14 @@ expopnode *parse_function_call(parser *prs, char *fn_name)
     int valid = 1;
     
     while(1) {
-        expression *exp = expression_parse(prs);
+        expression *exp = parse_subexpression(prs);
         if (exp == NULL) {
             valid = 0;
             break;
         }
         
         fun->args++;
-        funarg *arg = safe_calloc(1, sizeof(funarg));
+        funarg *arg = parser_alloc_node(prs, sizeof(funarg));
         arg->exp = exp;
         
         if (tail == NULL) {
@@ -358,7 +729,7 @@ expopnode *parse_function_call(parser *prs, char *fn_name)
         }
     }
     
-    if (!valid) {
+    if (!valid || !bind_function(prs, fun)) {
         free_function(&fun->opnode);
         return NULL;
     }
@@ -366,283 +737,372 @@ expopnode *parse_function_call(parser *prs, char *fn_name)
     return &fun->opnode;
 }
 
-
-struct binop_argtypes
+/* Bind a parsed function call to its builtin and check the number and
+ * types of its arguments, so none of that has to happen when the call
+ * runs.
+ * Returns 0 and sets a parser error on failure.
+ */
+int bind_function(parser *prs, funop *fun)
 {
-    valuetype left;
-    valuetype right;
-    int last;
-};
+    fun->fn = builtin_find(fun->name);
+    if (fun->fn == NULL) {
+        parser_set_error(prs, "FUNCTION %s IS NOT DEFINED", fun->name);
+        return 0;
+    }
+    
+    if (fun->args != fun->fn->args) {
+        parser_set_error(prs, "%s EXPECTS %d ARGUMENT%s", fun->fn->name, fun->fn->args, fun->fn->args == 1 ? "" : "S");
+        return 0;
+    }
+    
+    int argidx = 0;
+    for (funarg *arg = fun->arglist; arg; arg = arg->next, argidx++) {
+        arg->exp->root = promote(prs->nodes, arg->exp->root, fun->fn->types[argidx]);
+        
+        valuetype type = arg->exp->root->type;
+        if (type != fun->fn->types[argidx]) {
+            parser_set_error(prs, "%s EXPECTS %s FOR ARGUMENT %d, NOT %s",
+                fun->fn->name,
+                value_describe_type(fun->fn->types[argidx]),
+                argidx + 1,
+                value_describe_type(type));
+            return 0;
+        }
+    }
+    
+    fun->opnode.type = fun->fn->result;
+    return 1;
+}
+
 
-static binop_argtypes numbers[] =
+/* The operand types each operator accepts, and the evaluator which
+ * handles them. Both operands always have the same type; an integer
+ * operand is promoted to a number if the other one is a number, and
+ * both are promoted for division.
+ */
+struct binop_type
 {
-    { TYPE_NUMBER, TYPE_NUMBER, 1 },
+    token_type op;
+    valuetype operands;
+    valuetype result;
+    int (*evaluate)(expopnode *node, runtime *rt, value *result);
+    cellop cell;
 };
 
-static binop_argtypes numbers_and_strings[] =
+static binop_type binop_types[] =
 {
-    { TYPE_STRING, TYPE_STRING, 0 },
-    { TYPE_NUMBER, TYPE_NUMBER, 1 },
+    { TOK_PLUS, TYPE_NUMBER, TYPE_NUMBER, &eval_add_numbers, CELL_ADD },
+    { TOK_PLUS, TYPE_STRING, TYPE_STRING, &eval_concat_strings, CELL_STRINGS },
+    { TOK_MINUS, TYPE_NUMBER, TYPE_NUMBER, &eval_subtract_numbers, CELL_SUBTRACT },
+    { TOK_TIMES, TYPE_NUMBER, TYPE_NUMBER, &eval_multiply_numbers, CELL_MULTIPLY },
+    { TOK_DIVIDE, TYPE_NUMBER, TYPE_NUMBER, &eval_divide_numbers, CELL_DIVIDE },
+    { TOK_FIRSTRELOP, TYPE_NUMBER, TYPE_BOOLEAN, &eval_compare_numbers, CELL_COMPARE },
+    { TOK_PLUS, TYPE_INTEGER, TYPE_INTEGER, &eval_integer_arithmetic, CELL_INTEGER_ARITHMETIC },
+    { TOK_MINUS, TYPE_INTEGER, TYPE_INTEGER, &eval_integer_arithmetic, CELL_INTEGER_ARITHMETIC },
+    { TOK_TIMES, TYPE_INTEGER, TYPE_INTEGER, &eval_integer_arithmetic, CELL_INTEGER_ARITHMETIC },
+    { TOK_FIRSTRELOP, TYPE_INTEGER, TYPE_BOOLEAN, &eval_compare_integers, CELL_COMPARE_INTEGERS },
+    { TOK_FIRSTRELOP, TYPE_STRING, TYPE_BOOLEAN, &eval_compare_strings, CELL_STRINGS },
+    
+    { TOK_END, TYPE_VOID, TYPE_VOID, NULL, CELL_LITERAL }
 };
 
-/* validate the args that are passed to a binary operator are a compatible
- * type pair
+/* Find the evaluator for an operator and its operand types, or NULL
+ * if the operator can't be applied to them. Relational operators are
+ * all listed as TOK_FIRSTRELOP.
  */
-int binop_validate(const char *op, valuetype left, valuetype right, binop_argtypes *valid, runtime *rt)
+binop_type *find_binop_type(token_type op, valuetype left, valuetype right)
 {
-    for (int i = 0; ; i++, valid++)
-    {
-        if (valid->left == left && valid->right == right) {
-            return 1;
-        }
+    if (is_relop(op)) {
+        op = TOK_FIRSTRELOP;
+    }
     
-        if (valid->last) {
-            break;
-        }
+    if (left != right) {
+        return NULL;
     }
     
-    runtime_set_error(rt, "CANNOT %s %s AND %s", op, value_describe_type(left), value_describe_type(right));
+    for (binop_type *bt = &binop_types[0]; bt->evaluate; bt++) {
+        if (bt->op == op && bt->operands == left) {
+            return bt;
+        }
+    }
     
-    return 0;
+    return NULL;
 }
 
-/* runtime for < operator
+/* Returns the verb describing an operator, for errors
  */
-value *eval_less(expopnode *node, runtime *rt)
+const char *describe_binop(token_type op)
 {
-    binop *bop = (binop *)node;
-    value *left = bop->left->evaluate(bop->left, rt);
-    value *right = bop->right->evaluate(bop->right, rt);
-    
-    if (!binop_validate("COMPARE", left->type, right->type, numbers_and_strings, rt)) {
-        return NULL;
+    switch (op) {
+    case TOK_PLUS:      return "ADD";
+    case TOK_MINUS:     return "SUBTRACT";
+    case TOK_TIMES:     return "TIMES";
+    case TOK_DIVIDE:    return "DIVIDE";
+    default:            return "COMPARE";
+    }
+}
+
+/* Evaluate both operands of a binary operator. Returns 0 on failure,
+ * in which case neither holds anything.
+ */
+int eval_operands(binop *bop, runtime *rt, value *left, value *right)
+{
+    if (!bop->left->evaluate(bop->left, rt, left)) {
+        return 0;
     }
     
-    value *ret = NULL;
-    
-    if (left->type == TYPE_STRING && right->type == TYPE_STRING) {
-        ret = value_alloc_boolean(strcmp(left->string, right->string) < 0);
-    } else if (left->type == TYPE_NUMBER && right->type == TYPE_NUMBER) {
-        ret = value_alloc_boolean(left->number < right->number);
+    if (!bop->right->evaluate(bop->right, rt, right)) {
+        value_clear(left);
+        return 0;
     }
     
-    return ret;
+    return 1;
 }
 
-/* runtime for > operator
+/* The operator kernels. The parser only builds them over operands of
+ * the right type, so they don't check.
  */
-value *eval_greater(expopnode *node, runtime *rt)
+int eval_add_numbers(expopnode *node, runtime *rt, value *result)
 {
-    binop *bop = (binop *)node;
-    value *left = bop->left->evaluate(bop->left, rt);
-    value *right = bop->right->evaluate(bop->right, rt);
+    value left, right;
     
-    if (!binop_validate("COMPARE", left->type, right->type, numbers_and_strings, rt)) {
-        return NULL;
+    if (!eval_operands((binop *)node, rt, &left, &right)) {
+        return 0;
     }
     
-    value *ret = NULL;
+    value_set_number(result, left.number + right.number);
+    return 1;
+}
+
+int eval_subtract_numbers(expopnode *node, runtime *rt, value *result)
+{
+    value left, right;
     
-    if (left->type == TYPE_STRING && right->type == TYPE_STRING) {
-        ret = value_alloc_boolean(strcmp(left->string, right->string) > 0);
-    } else if (left->type == TYPE_NUMBER && right->type == TYPE_NUMBER) {
-        ret = value_alloc_boolean(left->number > right->number);
+    if (!eval_operands((binop *)node, rt, &left, &right)) {
+        return 0;
     }
     
-    return ret;
+    value_set_number(result, left.number - right.number);
+    return 1;
 }
 
-/* runtime for <= operator
- */
-value *eval_lesseq(expopnode *node, runtime *rt)
+int eval_multiply_numbers(expopnode *node, runtime *rt, value *result)
 {
-    binop *bop = (binop *)node;
-    value *left = bop->left->evaluate(bop->left, rt);
-    value *right = bop->right->evaluate(bop->right, rt);
+    value left, right;
     
-    if (!binop_validate("COMPARE", left->type, right->type, numbers_and_strings, rt)) {
-        return NULL;
+    if (!eval_operands((binop *)node, rt, &left, &right)) {
+        return 0;
     }
     
-    value *ret = NULL;
+    value_set_number(result, left.number * right.number);
+    return 1;
+}
+
+int eval_divide_numbers(expopnode *node, runtime *rt, value *result)
+{
+    value left, right;
     
-    if (left->type == TYPE_STRING && right->type == TYPE_STRING) {
-        ret = value_alloc_boolean(strcmp(left->string, right->string) <= 0);
-    } else if (left->type == TYPE_NUMBER && right->type == TYPE_NUMBER) {
-        ret = value_alloc_boolean(left->number <= right->number);
+    if (!eval_operands((binop *)node, rt, &left, &right)) {
+        return 0;
     }
     
-    return ret;
+    value_set_number(result, left.number / right.number);
+    return 1;
 }
 
-/* runtime for >= operator
- */
-value *eval_greatereq(expopnode *node, runtime *rt)
+int eval_compare_numbers(expopnode *node, runtime *rt, value *result)
 {
-    binop *bop = (binop *)node;
-    value *left = bop->left->evaluate(bop->left, rt);
-    value *right = bop->right->evaluate(bop->right, rt);
+    value left, right;
     
-    if (!binop_validate("COMPARE", left->type, right->type, numbers_and_strings, rt)) {
-        return NULL;
+    if (!eval_operands((binop *)node, rt, &left, &right)) {
+        return 0;
     }
     
-    value *ret = NULL;
+    value_set_boolean(result, compare(((binop *)node)->op, left.number, right.number));
+    return 1;
+}
+
+int eval_compare_integers(expopnode *node, runtime *rt, value *result)
+{
+    value left, right;
     
-    if (left->type == TYPE_STRING && right->type == TYPE_STRING) {
-        ret = value_alloc_boolean(strcmp(left->string, right->string) >= 0);
-    } else if (left->type == TYPE_NUMBER && right->type == TYPE_NUMBER) {
-        ret = value_alloc_boolean(left->number >= right->number);
+    if (!eval_operands((binop *)node, rt, &left, &right)) {
+        return 0;
     }
     
-    return ret;
+    /* compare the ordering rather than converting, to stay exact */
+    int order = (left.integer > right.integer) - (left.integer < right.integer);
+    value_set_boolean(result, compare(((binop *)node)->op, order, 0));
+    return 1;
 }
 
-/* runtime for = operator
+/* Integer +, - and *, which fail rather than wrapping around
  */
-value *eval_equal(expopnode *node, runtime *rt)
+int eval_integer_arithmetic(expopnode *node, runtime *rt, value *result)
 {
-    binop *bop = (binop *)node;
-    value *left = bop->left->evaluate(bop->left, rt);
-    value *right = bop->right->evaluate(bop->right, rt);
+    value left, right;
+    int64_t n;
     
-    if (!binop_validate("COMPARE", left->type, right->type, numbers_and_strings, rt)) {
-        return NULL;
+    if (!eval_operands((binop *)node, rt, &left, &right)) {
+        return 0;
     }
     
-    value *ret = NULL;
-    
-    if (left->type == TYPE_STRING && right->type == TYPE_STRING) {
-        ret = value_alloc_boolean(strcmp(left->string, right->string) == 0);
-    } else if (left->type == TYPE_NUMBER && right->type == TYPE_NUMBER) {
-    
-        // TODO floating point equality
-        ret = value_alloc_boolean(left->number == right->number);
+    if (!integer_arithmetic(((binop *)node)->op, left.integer, right.integer, &n)) {
+        runtime_set_error(rt, "INTEGER OVERFLOW");
+        return 0;
     }
     
-    return ret;
+    value_set_integer(result, n);
+    return 1;
 }
 
-/* runtime for <> operator
+/* Apply +, - or * to integers. Returns 0 if the result overflows.
  */
-value *eval_notequal(expopnode *node, runtime *rt)
+int integer_arithmetic(token_type op, int64_t left, int64_t right, int64_t *result)
 {
-    binop *bop = (binop *)node;
-    value *left = bop->left->evaluate(bop->left, rt);
-    value *right = bop->right->evaluate(bop->right, rt);
-    
-    if (!binop_validate("COMPARE", left->type, right->type, numbers_and_strings, rt)) {
-        return NULL;
+    switch (op) {
+    case TOK_PLUS:  return !__builtin_add_overflow(left, right, result);
+    case TOK_MINUS: return !__builtin_sub_overflow(left, right, result);
+    default:        return !__builtin_mul_overflow(left, right, result);
     }
+}
+
+int eval_concat_strings(expopnode *node, runtime *rt, value *result)
+{
+    value left, right;
     
-    value *ret = NULL;
+    if (!eval_operands((binop *)node, rt, &left, &right)) {
+        return 0;
+    }
     
-    if (left->type == TYPE_STRING && right->type == TYPE_STRING) {
-        ret = value_alloc_boolean(strcmp(left->string, right->string) != 0);
-    } else if (left->type == TYPE_NUMBER && right->type == TYPE_NUMBER) {
+    expression_string_binop(TOK_PLUS, &left, &right, result);
+    return 1;
+}
+
+int eval_compare_strings(expopnode *node, runtime *rt, value *result)
+{
+    value left, right;
     
-        // TODO floating point equality
-        ret = value_alloc_boolean(left->number != right->number);
+    if (!eval_operands((binop *)node, rt, &left, &right)) {
+        return 0;
     }
     
-    return ret;
+    expression_string_binop(((binop *)node)->op, &left, &right, result);
+    return 1;
 }
 
-/* runtime for + operator
+/* Apply + or a relational operator to two strings, clearing them. The
+ * VM shares this with the tree walker.
  */
-value *eval_plus(expopnode *node, runtime *rt)
+void expression_string_binop(token_type op, value *left, value *right, value *ret)
 {
-    binop *bop = (binop *)node;
-    value *left = bop->left->evaluate(bop->left, rt);
-    value *right = bop->right->evaluate(bop->right, rt);
-    
-    if (!binop_validate("ADD", left->type, right->type, numbers_and_strings, rt)) {
-        return NULL;
+    if (op == TOK_PLUS) {
+        value_set_string(ret, strobj_concat(left->string, right->string));
+    } else {
+        /* strings compare by their ordering against each other */
+        value_set_boolean(ret, compare(op, strobj_compare(left->string, right->string), 0));
     }
     
-    value *ret = NULL;
-    
-    if (left->type == TYPE_STRING && right->type == TYPE_STRING) {
-        size_t llen = strlen(left->string);
-        size_t rlen = strlen(right->string);
-        size_t n = llen + rlen + 1;
-        char *temp = safe_malloc(n);
-        strncpy(temp, left->string, n);
-        strncpy(temp + llen, right->string, n - llen);
-        ret = value_alloc_string(temp, VAL_COPY);
-    } else if (left->type == TYPE_NUMBER && right->type == TYPE_NUMBER) {
-        ret = value_alloc_number(left->number + right->number);
+    value_clear(left);
+    value_clear(right);
+}
+
+/* Apply a relational operator
+ */
+int compare(token_type op, double left, double right)
+{
+    switch (op) {
+    case TOK_LESSTHAN:      return left < right;
+    case TOK_GREATERTHAN:   return left > right;
+    case TOK_LESSEQUALS:    return left <= right;
+    case TOK_GREATEREQUALS: return left >= right;
+    case TOK_EQUALS:        return left == right;
+    default:                return left != right;
     }
-    
-    return ret;
 }
 
-/* runtime for - operator
+/* runtime for unary minus, which the parser only applies to numbers
  */
-value *eval_minus(expopnode *node, runtime *rt)
+int eval_unary_minus(expopnode *node, runtime *rt, value *result)
 {
-    binop *bop = (binop *)node;
-    value *left = bop->left->evaluate(bop->left, rt);
-    value *right = bop->right->evaluate(bop->right, rt);
+    unop *uop = (unop *)node;
     
-    if (!binop_validate("SUBTRACT", left->type, right->type, numbers, rt)) {
-        return NULL;
+    if (!uop->value->evaluate(uop->value, rt, result)) {
+        return 0;
     }
     
-    return value_alloc_number(left->number - right->number);
+    result->number = -result->number;
+    return 1;
 }
 
-/* runtime for * operator
+/* runtime for unary minus on an integer
  */
-value *eval_times(expopnode *node, runtime *rt)
+int eval_negate_integer(expopnode *node, runtime *rt, value *result)
 {
-    binop *bop = (binop *)node;
-    value *left = bop->left->evaluate(bop->left, rt);
-    value *right = bop->right->evaluate(bop->right, rt);
+    unop *uop = (unop *)node;
     
-    if (!binop_validate("TIMES", left->type, right->type, numbers, rt)) {
-        return NULL;
+    if (!uop->value->evaluate(uop->value, rt, result)) {
+        return 0;
+    }
+    
+    if (result->integer == INT64_MIN) {
+        runtime_set_error(rt, "INTEGER OVERFLOW");
+        return 0;
     }
     
-    return value_alloc_number(left->number * right->number);
+    result->integer = -result->integer;
+    return 1;
 }
 
-/* runtime for / operator
+/* runtime for promoting an integer to a number
  */
-value *eval_divide(expopnode *node, runtime *rt)
+int eval_to_number(expopnode *node, runtime *rt, value *result)
 {
-    binop *bop = (binop *)node;
-    value *left = bop->left->evaluate(bop->left, rt);
-    value *right = bop->right->evaluate(bop->right, rt);
+    unop *uop = (unop *)node;
     
-    if (!binop_validate("DIVIDE", left->type, right->type, numbers, rt)) {
-        return NULL;
+    if (!uop->value->evaluate(uop->value, rt, result)) {
+        return 0;
     }
     
-    return value_alloc_number(left->number / right->number);
+    value_set_number(result, (double)result->integer);
+    return 1;
 }
 
-/* runtime for unary minus
+/* runtime for truncating a number to an integer
  */
-value *eval_unary_minus(expopnode *node, runtime *rt)
+int eval_to_integer(expopnode *node, runtime *rt, value *result)
 {
     unop *uop = (unop *)node;
     
-    value *ret = NULL;
+    if (!uop->value->evaluate(uop->value, rt, result)) {
+        return 0;
+    }
     
-    value *val = uop->value->evaluate(uop->value, rt);
+    if (!expression_number_to_integer(result->number, &result->integer)) {
+        runtime_set_error(rt, "INTEGER OVERFLOW");
+        return 0;
+    }
     
-    if (val) {
-        if (val->type == TYPE_NUMBER) {
-            ret = value_alloc_number(-val->number);
-        }
+    result->type = TYPE_INTEGER;
+    return 1;
+}
+
+/* Truncate a number towards zero. Returns 0 if it's out of range for
+ * an integer. The VM shares this with the tree walker.
+ */
+int expression_number_to_integer(double number, int64_t *integer)
+{
+    /* written so that NaN fails too */
+    if (!(number >= -9223372036854775808.0 && number < 9223372036854775808.0)) {
+        return 0;
     }
     
-    return ret;
+    *integer = (int64_t)number;
+    return 1;
 }
 
 
-/* free a binary operator
+/* Free a binary operator's operands
  */
 void free_binop(expopnode *node)
 {
@@ -659,70 +1119,192 @@ void free_binop(expopnode *node)
     if (bop->right) {
         bop->right->free(bop->right);
     }
+}
+
+/* Compile a binary operator
+ */
+void compile_binop(expopnode *node, compiler *cmp)
+{
+    binop *bop = (binop *)node;
+    opcode op = OP_ADD;
+    
+    bop->left->compile(bop->left, cmp);
+    bop->right->compile(bop->right, cmp);
+    
+    if (bop->left->type == TYPE_STRING) {
+        compiler_emit_binop(cmp, bop->op == TOK_PLUS ? OP_CONCAT : OP_COMPARE_STRINGS, bop->op);
+        return;
+    }
+    
+    if (bop->left->type == TYPE_INTEGER) {
+        switch (bop->op) {
+        case TOK_PLUS:      op = OP_ADD_INT; break;
+        case TOK_MINUS:     op = OP_SUB_INT; break;
+        case TOK_TIMES:     op = OP_MUL_INT; break;
+        default:            op = OP_COMPARE_INT; break;
+        }
+        compiler_emit_binop(cmp, op, bop->op);
+        return;
+    }
+    
+    switch (bop->op) {
+    case TOK_LESSTHAN:      op = OP_LT; break;
+    case TOK_GREATERTHAN:   op = OP_GT; break;
+    case TOK_LESSEQUALS:    op = OP_LE; break;
+    case TOK_GREATEREQUALS: op = OP_GE; break;
+    case TOK_EQUALS:        op = OP_EQ; break;
+    case TOK_NOTEQUALS:     op = OP_NE; break;
+    case TOK_PLUS:          op = OP_ADD; break;
+    case TOK_MINUS:         op = OP_SUB; break;
+    case TOK_TIMES:         op = OP_MUL; break;
+    case TOK_DIVIDE:        op = OP_DIV; break;
+    default:                assert(0);
+    }
     
-    free(node);
+    compiler_emit_binop(cmp, op, bop->op);
 }
 
-/* Allocate a binary operator node
+/* Lower a binary operator
  */
-expopnode *alloc_binop(token_type op, expopnode *left, expopnode *right)
+void lower_binop(expopnode *node, lowering *low)
 {
-    binop *bop = safe_calloc(1, sizeof(binop));
-    bop->opnode.free = &free_binop;
+    binop *bop = (binop *)node;
     
-    switch (op) {
-    case TOK_LESSTHAN:
-        bop->opnode.evaluate = &eval_less;
-        break;
-        
-    case TOK_GREATERTHAN:
-        bop->opnode.evaluate = &eval_greater;
-        break;
-        
-    case TOK_LESSEQUALS:
-        bop->opnode.evaluate = &eval_lesseq;
-        break;
-        
-    case TOK_GREATEREQUALS:
-        bop->opnode.evaluate = &eval_greatereq;
-        break;
-        
-    case TOK_EQUALS:
-        bop->opnode.evaluate = &eval_equal;
-        break;
-        
-    case TOK_NOTEQUALS:
-        bop->opnode.evaluate = &eval_notequal;
-        break;
+    bop->left->lower(bop->left, low);
+    bop->right->lower(bop->right, low);
+    emit_cell(low, bop->cell, bop->op, 2);
+}
+
+/* Fold a binary operator. Operators on two literals are computed, as
+ * long as that can't fail, and identities which hold for any number
+ * are removed. Comparisons are left alone since there are no boolean
+ * literals to fold them into.
+ */
+expopnode *fold_binop(expopnode *node, arena *nodes)
+{
+    binop *bop = (binop *)node;
+    
+    bop->left = bop->left->fold(bop->left, nodes);
+    bop->right = bop->right->fold(bop->right, nodes);
+    
+    value *left = literal_value(bop->left);
+    value *right = literal_value(bop->right);
+    
+    if (left && right && !is_relop(bop->op)) {
+        /* evaluating literals doesn't need the runtime, and can only
+         * fail by overflowing an integer, which is left to be reported
+         * when the program runs
+         */
+        int64_t n;
+        if (left->type == TYPE_INTEGER && !integer_arithmetic(bop->op, left->integer, right->integer, &n)) {
+            return node;
+        }
         
+        value result;
+        node->evaluate(node, NULL, &result);
+        free_binop(node);
+        return alloc_literal(nodes, &result);
+    }
+    
+    /* the operand which is kept must be a number or an integer, as the
+     * identities don't hold for strings
+     */
+    switch (bop->op) {
     case TOK_PLUS:
-        bop->opnode.evaluate = &eval_plus;
-        break;
-        
+        if (is_literal_number(bop->left, 0) && is_arithmetic(bop->right)) {
+            return unwrap_binop(bop, &bop->right);
+        }
+        /* fall through */
     case TOK_MINUS:
-        bop->opnode.evaluate = &eval_minus;
+        if (is_literal_number(bop->right, 0) && is_arithmetic(bop->left)) {
+            return unwrap_binop(bop, &bop->left);
+        }
         break;
         
     case TOK_TIMES:
-        bop->opnode.evaluate = &eval_times;
-        break;
-            
+        if (is_literal_number(bop->left, 1) && is_arithmetic(bop->right)) {
+            return unwrap_binop(bop, &bop->right);
+        }
+        /* fall through */
     case TOK_DIVIDE:
-        bop->opnode.evaluate = &eval_divide;
+        if (is_literal_number(bop->right, 1) && is_arithmetic(bop->left)) {
+            return unwrap_binop(bop, &bop->left);
+        }
         break;
-            
+        
     default:
-        assert(0);
+        break;
+    }
+    
+    return node;
+}
+
+/* Free a binary operator except for one operand, which is returned
+ */
+expopnode *unwrap_binop(binop *bop, expopnode **keep)
+{
+    expopnode *ret = *keep;
+    *keep = NULL;
+    free_binop(&bop->opnode);
+    return ret;
+}
+
+/* Print a binary operator
+ */
+void dump_binop(expopnode *node, FILE *fp)
+{
+    binop *bop = (binop *)node;
+    
+    fprintf(fp, "(");
+    bop->left->dump(bop->left, fp);
+    fprintf(fp, " %s ", parser_describe_token_type(bop->op));
+    bop->right->dump(bop->right, fp);
+    fprintf(fp, ")");
+}
+
+/* Allocate a binary operator node, choosing the evaluator for its
+ * operand types. Returns NULL and sets a parser error (freeing the
+ * operands) if the operator doesn't apply to them.
+ */
+expopnode *alloc_binop(parser *prs, token_type op, expopnode *left, expopnode *right)
+{
+    assert(is_relop(op) || op == TOK_PLUS || op == TOK_MINUS || op == TOK_TIMES || op == TOK_DIVIDE);
+    
+    if (op != TOK_DIVIDE) {
+        integral_literal(left, right->type);
+        integral_literal(right, left->type);
     }
-   
     
+    if (op == TOK_DIVIDE || left->type == TYPE_NUMBER || right->type == TYPE_NUMBER) {
+        left = promote(prs->nodes, left, TYPE_NUMBER);
+        right = promote(prs->nodes, right, TYPE_NUMBER);
+    }
+    
+    binop_type *bt = find_binop_type(op, left->type, right->type);
+    if (bt == NULL) {
+        parser_set_error(prs, "CANNOT %s %s AND %s", describe_binop(op), value_describe_type(left->type), value_describe_type(right->type));
+        left->free(left);
+        right->free(right);
+        return NULL;
+    }
+    
+    binop *bop = parser_alloc_node(prs, sizeof(binop));
+    bop->opnode.type = bt->result;
+    bop->opnode.free = &free_binop;
+    bop->opnode.evaluate = bt->evaluate;
+    bop->cell = bt->cell;
+    bop->opnode.compile = &compile_binop;
+    bop->opnode.lower = &lower_binop;
+    bop->opnode.fold = &fold_binop;
+    bop->opnode.dump = &dump_binop;
+    bop->op = op;
     bop->left = left;
     bop->right = right;
     
     return &bop->opnode;
 }
 
-/* Free unary op code
+/* Free unary op code's operand
  */
 void free_unop(expopnode *node)
 {
@@ -731,127 +1313,470 @@ void free_unop(expopnode *node)
     if (uop && uop->value) {
         uop->value->free(uop->value);
     }
+}
+
+/* Compile unary op
+ */
+void compile_unop(expopnode *node, compiler *cmp)
+{
+    unop *uop = (unop *)node;
+    
+    uop->value->compile(uop->value, cmp);
+    compiler_emit(cmp, uop->opnode.type == TYPE_INTEGER ? OP_NEG_INT : OP_NEG);
+}
+
+/* Lower unary op
+ */
+void lower_unop(expopnode *node, lowering *low)
+{
+    unop *uop = (unop *)node;
     
-    free(node);
+    uop->value->lower(uop->value, low);
+    emit_cell(low, node->type == TYPE_INTEGER ? CELL_NEGATE_INTEGER : CELL_NEGATE, 0, 1);
+}
+
+/* Fold unary op by negating a literal number
+ */
+expopnode *fold_unop(expopnode *node, arena *nodes)
+{
+    unop *uop = (unop *)node;
+    
+    uop->value = uop->value->fold(uop->value, nodes);
+    
+    value *val = literal_value(uop->value);
+    if (val && (val->type == TYPE_NUMBER || (val->type == TYPE_INTEGER && val->integer != INT64_MIN))) {
+        expopnode *lit = uop->value;
+        
+        val->number = -val->number;
+        val->integer = -val->integer;
+        uop->value = NULL;
+        free_unop(node);
+        return lit;
+    }
+    
+    return node;
+}
+
+/* Print unary op
+ */
+void dump_unop(expopnode *node, FILE *fp)
+{
+    unop *uop = (unop *)node;
+    
+    fprintf(fp, "-");
+    uop->value->dump(uop->value, fp);
 }
 
 /* Allocate unary op
  */
-expopnode *alloc_unop(token_type op, expopnode *value)
+expopnode *alloc_unop(parser *prs, token_type op, expopnode *value)
 {
     assert(op == TOK_MINUS);
     
-    unop *uop = safe_calloc(1, sizeof(unop));
+    if (!is_arithmetic(value)) {
+        parser_set_error(prs, "CANNOT NEGATE %s", value_describe_type(value->type));
+        value->free(value);
+        return NULL;
+    }
+    
+    unop *uop = parser_alloc_node(prs, sizeof(unop));
+    uop->opnode.type = value->type;
 
     uop->value = value;
     uop->opnode.free = &free_unop;
-    uop->opnode.evaluate = &eval_unary_minus;
+    uop->opnode.evaluate = value->type == TYPE_INTEGER ? &eval_negate_integer : &eval_unary_minus;
+    uop->opnode.compile = &compile_unop;
+    uop->opnode.lower = &lower_unop;
+    uop->opnode.fold = &fold_unop;
+    uop->opnode.dump = &dump_unop;
     
     return &uop->opnode;
 }
 
+/* Compile a conversion between integers and numbers
+ */
+void compile_convert(expopnode *node, compiler *cmp)
+{
+    unop *uop = (unop *)node;
+    
+    uop->value->compile(uop->value, cmp);
+    compiler_emit(cmp, uop->opnode.type == TYPE_INTEGER ? OP_TO_INTEGER : OP_TO_NUMBER);
+}
+
+/* Lower a conversion between integers and numbers
+ */
+void lower_convert(expopnode *node, lowering *low)
+{
+    unop *uop = (unop *)node;
+    
+    uop->value->lower(uop->value, low);
+    emit_cell(low, node->type == TYPE_INTEGER ? CELL_TO_INTEGER : CELL_TO_NUMBER, 0, 1);
+}
+
+/* Fold a conversion of a literal
+ */
+expopnode *fold_convert(expopnode *node, arena *nodes)
+{
+    unop *uop = (unop *)node;
+    value result;
+    
+    uop->value = uop->value->fold(uop->value, nodes);
+    
+    value *val = literal_value(uop->value);
+    if (val == NULL) {
+        return node;
+    }
+    
+    if (node->type == TYPE_NUMBER) {
+        value_set_number(&result, (double)val->integer);
+    } else if (expression_number_to_integer(val->number, &result.integer)) {
+        result.type = TYPE_INTEGER;
+    } else {
+        /* out of range, which is reported when the program runs */
+        return node;
+    }
+    
+    free_unop(node);
+    return alloc_literal(nodes, &result);
+}
+
+/* Print a conversion
+ */
+void dump_convert(expopnode *node, FILE *fp)
+{
+    unop *uop = (unop *)node;
+    
+    fprintf(fp, "%s(", value_describe_type(node->type));
+    uop->value->dump(uop->value, fp);
+    fprintf(fp, ")");
+}
+
+/* Allocate a conversion of value to type, which must be one of number
+ * or integer while value is the other
+ */
+expopnode *alloc_convert(arena *nodes, expopnode *value, valuetype type)
+{
+    unop *uop = arena_calloc(nodes, 1, sizeof(unop));
+    
+    uop->opnode.type = type;
+    uop->opnode.free = &free_unop;
+    uop->opnode.evaluate = type == TYPE_INTEGER ? &eval_to_integer : &eval_to_number;
+    uop->opnode.compile = &compile_convert;
+    uop->opnode.lower = &lower_convert;
+    uop->opnode.fold = &fold_convert;
+    uop->opnode.dump = &dump_convert;
+    uop->value = value;
+    
+    return &uop->opnode;
+}
+
+/* Convert node to type, between numbers and integers in either
+ * direction. Returns NULL (leaving node alone) if that isn't possible.
+ */
+expopnode *convert(arena *nodes, expopnode *node, valuetype type)
+{
+    integral_literal(node, type);
+    
+    if (node->type == type) {
+        return node;
+    }
+    
+    if (!is_arithmetic(node) || (type != TYPE_NUMBER && type != TYPE_INTEGER)) {
+        return NULL;
+    }
+    
+    return alloc_convert(nodes, node, type);
+}
+
+/* Promote node to a number if it's an integer and type is number, as
+ * is done implicitly when they're mixed. Anything else is unchanged.
+ */
+expopnode *promote(arena *nodes, expopnode *node, valuetype type)
+{
+    if (node->type == TYPE_INTEGER && type == TYPE_NUMBER) {
+        return alloc_convert(nodes, node, TYPE_NUMBER);
+    }
+    
+    return node;
+}
+
 /* Evaluate a literal
  */
-value *eval_literal(expopnode *node, runtime *rt)
+int eval_literal(expopnode *node, runtime *rt, value *result)
 {
     litop *lop = (litop *)node;
-    return value_clone(lop->literal);
+    value_copy(result, &lop->literal);
+    return 1;
 }
 
-/* Free a literal
+/* Free a literal's string, if it has one
  */
 void free_litop(expopnode *node)
 {
     litop *lop = (litop *)node;
     if (lop) {
-        value_free(lop->literal);
+        value_clear(&lop->literal);
+    }
+}
+
+/* Compile a literal
+ */
+void compile_litop(expopnode *node, compiler *cmp)
+{
+    litop *lop = (litop *)node;
+    
+    if (lop->literal.type == TYPE_STRING) {
+        compiler_emit_string(cmp, lop->literal.string);
+    } else if (lop->literal.type == TYPE_INTEGER) {
+        compiler_emit_integer(cmp, lop->literal.integer);
+    } else {
+        compiler_emit_number(cmp, lop->literal.number);
+    }
+}
+
+/* Lower a literal
+ */
+void lower_litop(expopnode *node, lowering *low)
+{
+    litop *lop = (litop *)node;
+    emit_cell(low, CELL_LITERAL, 0, 0)->u.literal = lop->literal;
+}
+
+/* Print a literal
+ */
+void dump_litop(expopnode *node, FILE *fp)
+{
+    litop *lop = (litop *)node;
+    
+    if (lop->literal.type == TYPE_STRING) {
+        fprintf(fp, "\"%s\"", lop->literal.string->text);
+    } else if (lop->literal.type == TYPE_INTEGER) {
+        fprintf(fp, "%lld", (long long)lop->literal.integer);
+    } else {
+        char buf[NUMFORMAT_SIZE];
+        numformat_double(lop->literal.number, buf);
+        fprintf(fp, "%s", buf);
     }
-    free(node);
 }
 
-/* Allocate a literal
+/* Allocate a literal, taking over anything val owns
  */
-expopnode *alloc_literal(value *value)
+expopnode *alloc_literal(arena *nodes, value *val)
 {
-    litop *lop = calloc(1, sizeof(litop));
+    litop *lop = arena_calloc(nodes, 1, sizeof(litop));
+    lop->opnode.type = val->type;
     lop->opnode.free = &free_litop;
     lop->opnode.evaluate = &eval_literal;
-    lop->literal = value;
+    lop->opnode.compile = &compile_litop;
+    lop->opnode.lower = &lower_litop;
+    lop->opnode.fold = &fold_none;
+    lop->opnode.dump = &dump_litop;
+    lop->literal = *val;
     return &lop->opnode;
 }
 
+/* Returns the value of node if it's a literal, else NULL
+ */
+value *literal_value(expopnode *node)
+{
+    if (node->evaluate != &eval_literal) {
+        return NULL;
+    }
+    
+    return &((litop *)node)->literal;
+}
+
+/* Returns true if node is a literal with the given numeric value
+ */
+int is_literal_number(expopnode *node, double number)
+{
+    value *val = literal_value(node);
+    if (val && val->type == TYPE_INTEGER) {
+        return val->integer == number;
+    }
+    return val && val->type == TYPE_NUMBER && val->number == number;
+}
+
+/* Number literals are numbers, but one written as a whole number (or
+ * its negation) which meets an integer (type) becomes an integer too,
+ * so that I% + 1 stays exact while 100000000000 * 100000000000 is
+ * still 1E22
+ */
+void integral_literal(expopnode *node, valuetype type)
+{
+    if (type != TYPE_INTEGER) {
+        return;
+    }
+    
+    expopnode *lit = node;
+    if (node->evaluate == &eval_unary_minus) {
+        lit = ((unop *)node)->value;
+    }
+    
+    value *val = literal_value(lit);
+    if (val == NULL || val->type != TYPE_NUMBER || !((litop *)lit)->exact) {
+        return;
+    }
+    
+    val->type = TYPE_INTEGER;
+    lit->type = TYPE_INTEGER;
+    
+    if (node != lit) {
+        node->type = TYPE_INTEGER;
+        node->evaluate = &eval_negate_integer;
+    }
+}
+
+/* Returns true if node evaluates to a number or an integer
+ */
+int is_arithmetic(expopnode *node)
+{
+    return node->type == TYPE_NUMBER || node->type == TYPE_INTEGER;
+}
+
+/* Parse a number literal. It's a number even if it's written without a
+ * decimal point; see integral_literal for where it becomes an integer.
+ */
+expopnode *parse_number_literal(parser *prs)
+{
+    const char *text = prs->line_buffer + prs->token_start;
+    int len = prs->token_end - prs->token_start;
+    value val;
+    double num;
+    int64_t n;
+    
+    numparse_double(text, &num);
+    value_set_number(&val, num);
+    
+    int exact = numparse_integer(text, &n) == len;
+    val.integer = exact ? n : 0;
+    
+    parse_next_token(prs);
+    
+    expopnode *node = alloc_literal(prs->nodes, &val);
+    ((litop *)node)->exact = exact;
+    return node;
+}
+
 /* evalute a variable reference
  */
-value *eval_varref(expopnode *node, runtime *rt)
+int eval_varref(expopnode *node, runtime *rt, value *result)
 {
     varref *var = (varref *)node;
-    return value_clone(runtime_getvar(rt, var->varname));
+    if (!runtime_getvar(rt, var->slot, result)) {
+        runtime_set_error(rt, "VARIABLE %s IS NOT DEFINED", var->varname);
+        return 0;
+    }
+    
+    return 1;
 }
 
-/* free a variable reference
+/* compile a variable reference
  */
-void free_varref(expopnode *node)
+void compile_varref(expopnode *node, compiler *cmp)
 {
     varref *var = (varref *)node;
-    if (var) {
-        free(var->varname);
-    }
-    free(var);
+    compiler_emit_var(cmp, OP_LOAD, var->slot, var->varname);
+}
+
+/* lower a variable reference
+ */
+void lower_varref(expopnode *node, lowering *low)
+{
+    varref *var = (varref *)node;
+    emit_cell(low, CELL_VAR, var->slot, 0)->u.name = var->varname;
+}
+
+/* print a variable reference
+ */
+void dump_varref(expopnode *node, FILE *fp)
+{
+    varref *var = (varref *)node;
+    fprintf(fp, "%s", var->varname);
 }
 
 /* allocate a variable reference
  */
-expopnode *alloc_varref(char *varname)
+expopnode *alloc_varref(arena *nodes, char *varname)
 {
-    varref *var = calloc(1, sizeof(varref));
+    varref *var = arena_calloc(nodes, 1, sizeof(varref));
     
-    var->opnode.free = &free_varref;
+    var->opnode.free = &free_none;
     var->opnode.evaluate = &eval_varref;
+    var->opnode.compile = &compile_varref;
+    var->opnode.lower = &lower_varref;
+    var->opnode.fold = &fold_none;
+    var->opnode.dump = &dump_varref;
     var->varname = varname;
+    var->slot = runtime_var_slot(varname);
+    var->opnode.type = runtime_var_type(var->slot);
     
     return &var->opnode;
 }
 
 /* Clean up arguments evaluated for a function call
  */
-void cleanup_funargs(int argc, value **argv)
+void cleanup_funargs(int argc, value *argv)
 {
     for (int i = 0; i < argc; ++i) {
-        value_free(argv[i]);
+        value_clear(&argv[i]);
     }
-    free(argv);
 }
 
-/* Evaluate a function call
+/* Evaluate a function call. The arity was checked when the call was
+ * parsed, so the arguments always fit in a fixed buffer.
  */
-value *eval_function(expopnode *node, runtime *rt)
+int eval_function(expopnode *node, runtime *rt, value *result)
 {
     funop *fun = (funop *)node;
-    value **argv = safe_calloc(fun->args, sizeof(value*));
+    value argv[BUILTIN_MAX_ARGS];
     
     int argidx = 0;
     for (funarg *arg = fun->arglist; arg; arg = arg->next) {
-        if ((argv[argidx++] = expression_evaluate(arg->exp, rt)) == NULL) {
-            break;
+        if (!expression_evaluate(arg->exp, rt, &argv[argidx])) {
+            /* argument evaluation failed, which will have already
+             * set a runtime error
+             */
+            cleanup_funargs(argidx, argv);
+            return 0;
         }
+        argidx++;
     }
     
-    if (argidx < fun->args) {
-        /* argument evaluation failed, which will have already
-         * set a runtime error
-         */
-        cleanup_funargs(fun->args, argv);
-        return NULL;
+    int ok = builtin_execute(rt, fun->fn, argv, result);
+    
+    cleanup_funargs(fun->args, argv);
+    
+    return ok;
+}
+
+/* Compile a function call
+ */
+void compile_function(expopnode *node, compiler *cmp)
+{
+    funop *fun = (funop *)node;
+    
+    for (funarg *arg = fun->arglist; arg; arg = arg->next) {
+        expression_compile(arg->exp, cmp);
     }
     
-    value *ret = builtin_execute(rt, fun->name, fun->args, argv);
+    compiler_emit_call(cmp, fun->fn);
+}
+
+/* Lower a function call
+ */
+void lower_function(expopnode *node, lowering *low)
+{
+    funop *fun = (funop *)node;
     
-    cleanup_funargs(fun->args, argv);
+    for (funarg *arg = fun->arglist; arg; arg = arg->next) {
+        arg->exp->root->lower(arg->exp->root, low);
+    }
     
-    return ret;
+    emit_cell(low, CELL_CALL, fun->args, fun->args)->u.fn = fun->fn;
 }
 
-/* Free a function call node
+/* Free a function call node's arguments
  */
 void free_function(expopnode *node)
 {
@@ -860,14 +1785,68 @@ void free_function(expopnode *node)
         return;
     }
     
-    free(fun->name);
+    for (funarg *arg = fun->arglist; arg; arg = arg->next) {
+        expression_free(arg->exp);
+    }
+}
+
+/* Fold a function call's arguments. If the function is pure and they
+ * are all literals of the right type, the call is made now.
+ */
+expopnode *fold_function(expopnode *node, arena *nodes)
+{
+    funop *fun = (funop *)node;
+    value argv[BUILTIN_MAX_ARGS];
+    int constant = (fun->fn->flags & BIFL_PURE) != 0;
+    
+    int argidx = 0;
+    for (funarg *arg = fun->arglist; arg; arg = arg->next, argidx++) {
+        arg->exp->root = arg->exp->root->fold(arg->exp->root, nodes);
+        
+        value *val = literal_value(arg->exp->root);
+        if (val == NULL || val->type != fun->fn->types[argidx]) {
+            constant = 0;
+        } else {
+            argv[argidx] = *val;
+        }
+    }
     
-    while (fun->arglist) {
-        funarg *next = fun->arglist->next;
-        expression_free(fun->arglist->exp);
-        free(fun->arglist);
-        fun->arglist = next;
+    if (!constant) {
+        return node;
     }
     
-    free(fun);
+    value result;
+    fun->fn->execute(NULL, argv, &result);
+    free_function(node);
+    
+    return alloc_literal(nodes, &result);
+}
+
+/* Print a function call
+ */
+void dump_function(expopnode *node, FILE *fp)
+{
+    funop *fun = (funop *)node;
+    
+    fprintf(fp, "%s(", fun->fn->name);
+    for (funarg *arg = fun->arglist; arg; arg = arg->next) {
+        arg->exp->root->dump(arg->exp->root, fp);
+        if (arg->next) {
+            fprintf(fp, ", ");
+        }
+    }
+    fprintf(fp, ")");
+}
+
+/* Free for nodes which hold nothing outside of their arena
+ */
+void free_none(expopnode *node)
+{
+}
+
+/* Fold for nodes which are already as simple as they can be
+ */
+expopnode *fold_none(expopnode *node, arena *nodes)
+{
+    return node;
 }
@@ -1,20 +1,55 @@
 #ifndef expression_h
 #define expression_h
 
+#include <stdio.h>
+
+#include "value.h"
+
+typedef struct arena arena;
+typedef struct compiler compiler;
 typedef struct expopnode expopnode;
 typedef struct expression expression;
+typedef struct lowering lowering;
 typedef struct parser parser;
 typedef struct runtime runtime;
-typedef struct value value;
+typedef enum token_type token_type;
 
+/* evaluate stores the result in caller provided storage, which then
+ * owns any string payload. It returns 0 if evaluation failed, in which
+ * case a runtime error has been set and the result holds nothing.
+ *
+ * type is the type of value evaluate produces, which the parser
+ * knows for every node.
+ *
+ * Nodes live in the arena of the statement they're parsed for, so free
+ * only releases what a node holds outside of it, such as strings.
+ *
+ * fold returns the node to use in place of node once constant parts of
+ * it have been computed; if that isn't node, node has been freed. Any
+ * new nodes come from nodes.
+ *
+ * Once an expression is parsed, the tree is lowered into a flat postfix
+ * array, which is what evaluation runs; lower appends the node's part.
+ */
 struct expopnode
 {
-    value *(*evaluate)(expopnode *node, runtime *rt);
+    valuetype type;
+    int (*evaluate)(expopnode *node, runtime *rt, value *result);
     void (*free)(expopnode *node);
+    void (*compile)(expopnode *node, compiler *cmp);
+    void (*lower)(expopnode *node, lowering *low);
+    expopnode *(*fold)(expopnode *node, arena *nodes);
+    void (*dump)(expopnode *node, FILE *fp);
 };
 
 expression *expression_parse(parser *prs);
 void expression_free(expression *exp);
-value *expression_evaluate(expression *exp, runtime *rt);
+int expression_evaluate(expression *exp, runtime *rt, value *result);
+void expression_compile(expression *exp, compiler *cmp);
+valuetype expression_type(expression *exp);
+int expression_convert(expression *exp, valuetype type);
+int expression_strip_append(expression *exp, int slot);
+void expression_string_binop(token_type op, value *left, value *right, value *ret);
+int expression_number_to_integer(double number, int64_t *integer);
 
 #endif /* expression_h */
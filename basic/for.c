@@ -1,29 +1,31 @@
 #include <string.h>
 
+#include "compile.h"
 #include "expression.h"
 #include "for.h"
 #include "parser.h"
 #include "runtime.h"
-#include "safemem.h"
 #include "scope.h"
 #include "statement.h"
 #include "stringutil.h"
 #include "value.h"
+#include "vartable.h"
 
 typedef struct for_node for_node;
-typedef struct for_scope for_scope;
 typedef struct next_node next_node;
 
 static void for_free(statement_body *body);
 static void for_execute(statement_body *body, runtime *rt);
-static void for_scope_free(scope *scope);
-static void next_free(statement_body *body);
+static void for_compile(statement_body *body, compiler *cmp);
+static void for_exit(scope_stack *stk, int slot);
 static void next_execute(statement_body *body, runtime *rt);
+static void next_compile(statement_body *body, compiler *cmp);
 
 struct for_node
 {
     statement_body body;
     char *id;
+    int slot;
     expression *start;
     expression *limit;
     expression *step;
@@ -33,27 +35,14 @@ struct next_node
 {
     statement_body body;
     char *id;
-};
-
-struct for_scope
-{
-    scope scope;
-    
-    statement *loop_top;
-    
-    /* note that since these never change, ownership remains with
-     * the for_node and we should NOT free them when the scope exits.
-     */
-    char *id;
-    value *limit;
-    value *step;
+    int slot;
 };
 
 /* Parse a FOR statement
  */
 void for_parse(parser *prs, statement *stmt)
 {
-    for_node *forn = safe_calloc(1, sizeof(for_node));
+    for_node *forn = parser_alloc_node(prs, sizeof(for_node));
     
     if ((forn->id = parser_expect_var(prs)) == NULL ||
         !parser_expect_operator(prs, TOK_EQUALS) ||
@@ -80,9 +69,23 @@ void for_parse(parser *prs, statement *stmt)
     }
     
     strupr(forn->id);
+    forn->slot = runtime_var_slot(forn->id);
+    
+    /* the loop values take the index's type, so an integer index
+     * steps with integer arithmetic
+     */
+    valuetype type = runtime_var_type(forn->slot);
+    if (!expression_convert(forn->start, type) ||
+        !expression_convert(forn->limit, type) ||
+        (forn->step && !expression_convert(forn->step, type))) {
+        parser_set_error(prs, "FOR LOOP VALUES MUST BE NUMBERS");
+        for_free(&forn->body);
+        return;
+    }
     
     forn->body.execute = &for_execute;
     forn->body.free = &for_free;
+    forn->body.compile = &for_compile;
     stmt->body = &forn->body;
 }
 
@@ -90,60 +93,36 @@ void for_parse(parser *prs, statement *stmt)
  */
 void next_parse(parser *prs, statement *stmt)
 {
-    next_node *next = safe_calloc(1, sizeof(next_node));
+    next_node *next = parser_alloc_node(prs, sizeof(next_node));
     
     if (prs->token_type != TOK_END) {
         if ((next->id = parser_expect_var(prs)) == NULL ||
             !parser_expect_end_of_line(prs)) {
-            next_free(&next->body);
             return;
         }
     }
     
+    next->slot = -1;
     if (next->id) {
         strupr(next->id);
+        next->slot = runtime_var_slot(next->id);
     }
     
     next->body.execute = next_execute;
-    next->body.free = next_free;
+    next->body.compile = next_compile;
     
     stmt->body = &next->body;
 }
 
-/* Free a FOR node
+/* Free a FOR node's expressions
  */
 void for_free(statement_body *body)
 {
     for_node *forn = (for_node *)body;
     
-    if (forn) {
-        free(forn->id);
-        expression_free(forn->start);
-        expression_free(forn->limit);
-        expression_free(forn->step);
-    }
-
-    free(body);
-}
-
-/* Free a NEXT node 
- */
-void next_free(statement_body *body)
-{
-    next_node *next = (next_node *)body;
-    
-    if (next) {
-        free(next->id);
-    }
-    
-    free(body);
-}
-
-/* Free a for scope
- */
-void for_scope_free(scope *scp)
-{
-    free(scp);
+    expression_free(forn->start);
+    expression_free(forn->limit);
+    expression_free(forn->step);
 }
 
 /* Execute for
@@ -151,11 +130,6 @@ void for_scope_free(scope *scp)
 void for_execute(statement_body *body, runtime *rt)
 {
     for_node *forn = (for_node *)body;
-    for_scope *scp = safe_calloc(1, sizeof(for_scope));
-    
-    scp->scope.free = &for_scope_free;
-    scp->scope.type = SCOPE_FOR;
-    scp->id = forn->id;
     
     /* NOTE that we lock the loop iteration parameters the first time through
      * the loop. This means that if the body of the loop changes the values
@@ -170,13 +144,104 @@ void for_execute(statement_body *body, runtime *rt)
      *
      * Note that the code *can* change the loop index variable (I in this case)
      */
-    scp->limit = expression_evaluate(forn->limit, rt);
-    scp->step = forn->step ? expression_evaluate(forn->step, rt) : value_alloc_number(1);
-    scp->loop_top = runtime_next_statement(rt);
+    value limit;
+    value step;
+    value start;
+    
+    if (!expression_evaluate(forn->limit, rt, &limit)) {
+        return;
+    }
+    
+    if (forn->step == NULL) {
+        if (runtime_var_type(forn->slot) == TYPE_INTEGER) {
+            value_set_integer(&step, 1);
+        } else {
+            value_set_number(&step, 1);
+        }
+    } else if (!expression_evaluate(forn->step, rt, &step)) {
+        value_clear(&limit);
+        return;
+    }
     
-    runtime_setvar(rt, scp->id, expression_evaluate(forn->start, rt));
+    if (!expression_evaluate(forn->start, rt, &start)) {
+        value_clear(&limit);
+        value_clear(&step);
+        return;
+    }
+    
+    for_enter(rt, forn->slot, forn->id, &start, &limit, &step, runtime_next_statement(rt));
+}
 
-    scope_stack_push(runtime_scope_stack(rt), &scp->scope);
+/* Compile for. The expressions are evaluated in the same order as
+ * for_execute so side effects (such as TAB) happen in the same order.
+ */
+void for_compile(statement_body *body, compiler *cmp)
+{
+    for_node *forn = (for_node *)body;
+    
+    expression_compile(forn->limit, cmp);
+    if (forn->step) {
+        expression_compile(forn->step, cmp);
+    } else if (runtime_var_type(forn->slot) == TYPE_INTEGER) {
+        compiler_emit_integer(cmp, 1);
+    } else {
+        compiler_emit_number(cmp, 1);
+    }
+    expression_compile(forn->start, cmp);
+    compiler_emit_var(cmp, OP_FOR, forn->slot, forn->id);
+    compiler_open_loop(cmp, forn->slot);
+}
+
+/* Start a loop: set the index variable and push the loop's scope.
+ * The values all have the index's type. loop_top is the first statement
+ * of the loop body. Returns 0 and sets a runtime error if the stack is
+ * full.
+ */
+int for_enter(runtime *rt, int slot, const char *id, value *start, value *limit, value *step, statement *loop_top)
+{
+    scope_stack *stk = runtime_scope_stack(rt);
+    
+    for_exit(stk, slot);
+    
+    scope *scp = scope_stack_push(stk, SCOPE_FOR);
+    if (scp == NULL) {
+        runtime_set_error(rt, "STACK OVERFLOW");
+        return 0;
+    }
+    
+    for_scope *loop = &scp->u.loop;
+    
+    loop->id = id;
+    loop->slot = slot;
+    loop->loop_top = loop_top;
+    loop->loop_pc = loop_top ? loop_top->pc : -1;
+    
+    if (vartable_type(slot) == TYPE_INTEGER) {
+        loop->limit.integer = limit->integer;
+        loop->step.integer = step->integer;
+    } else {
+        loop->limit.number = limit->number;
+        loop->step.number = step->number;
+    }
+    
+    runtime_setvar(rt, slot, start);
+    return 1;
+}
+
+/* If a loop on the same index is already active in the current
+ * subroutine, it was abandoned with a GOTO; pop it, and any loops nested
+ * in it, so that a program which keeps doing this runs in bounded memory.
+ */
+void for_exit(scope_stack *stk, int slot)
+{
+    for (int i = stk->depth - 1; i >= 0 && stk->frames[i].type == SCOPE_FOR; i--) {
+        if (stk->frames[i].u.loop.slot == slot) {
+            while (stk->depth > i) {
+                scope_stack_pop(stk);
+            }
+            return;
+        }
+    }
 }
 
 /* Execute next
@@ -184,40 +249,89 @@ void for_execute(statement_body *body, runtime *rt)
 void next_execute(statement_body *body, runtime *rt)
 {
     next_node *next = (next_node *)body;
-    scope_stack *stk = runtime_scope_stack(rt);
+    statement *loop_top = NULL;
     
-    if (stk->top == NULL || stk->top->type != SCOPE_FOR) {
-        runtime_set_error(rt, "NESTING ERROR");
-        return;
+    if (for_next(rt, next->slot, next->id, &loop_top) && loop_top) {
+        runtime_set_next_statement(rt, loop_top);
     }
+}
+
+/* Compile next
+ */
+void next_compile(statement_body *body, compiler *cmp)
+{
+    next_node *next = (next_node *)body;
+    int body_pc;
+    int slot = compiler_close_loop(cmp, next->slot, &body_pc);
     
-    for_scope *scp = (for_scope *)stk->top;
-    
-    if (next->id != NULL && strcasecmp(scp->id, next->id) != 0) {
-        runtime_set_error(rt, "NEXT INDEX %s DOES NOT MATCH FOR INDEX %s", next->id, scp->id);
-        return;
+    /* if the compiler found the FOR, step that loop directly when it's
+     * the innermost one; OP_NEXT handles everything else, including
+     * errors
+     */
+    if (slot != -1) {
+        opcode op = runtime_var_type(slot) == TYPE_INTEGER ? OP_NEXT_INT : OP_NEXT_NUM;
+        compiler_emit_next(cmp, op, slot, body_pc);
     }
+    compiler_emit_var(cmp, OP_NEXT, next->slot, next->id);
+}
+
+/* Step the innermost loop, whose index must be in slot unless slot is
+ * -1. id is the index's name, for error messages. Returns 0 and sets a
+ * runtime error on failure. Otherwise returns 1, with loop_top set to
+ * the statement to loop back to, or NULL if the loop is finished.
+ */
+int for_next(runtime *rt, int slot, const char *id, statement **loop_top)
+{
+    scope_stack *stk = runtime_scope_stack(rt);
     
-    value *index = runtime_getvar(rt, scp->id);
-    if (index->type != TYPE_NUMBER) {
-        /* this should be impossible */
-        runtime_set_error(rt, "INDEX VARIABLE %s IS NO LONGER A NUMBER", scp->id);
-        return;
+    *loop_top = NULL;
+    
+    scope *top = scope_stack_top(stk);
+    
+    if (top == NULL || top->type != SCOPE_FOR) {
+        runtime_set_error(rt, "NESTING ERROR");
+        return 0;
     }
     
-    double delta = scp->step->number;
-    index->number += delta;
+    for_scope *scp = &top->u.loop;
     
+    if (slot != -1 && scp->slot != slot) {
+        runtime_set_error(rt, "NEXT INDEX %s DOES NOT MATCH FOR INDEX %s", id, scp->id);
+        return 0;
+    }
+    
+    varcell *index = &runtime_vars(rt)->cells[scp->slot];
     int done = 0;
-    if (delta < 0) {
-        done = index->number < scp->limit->number;
+    
+    if (vartable_type(scp->slot) == TYPE_INTEGER) {
+        int64_t delta = scp->step.integer;
+        int64_t next;
+        
+        /* stepping past the largest or smallest integer also ends
+         * the loop, since the limit must have been passed
+         */
+        if (__builtin_add_overflow(index->integer, delta, &next)) {
+            done = 1;
+        } else {
+            index->integer = next;
+            done = delta < 0 ? next < scp->limit.integer : next > scp->limit.integer;
+        }
     } else {
-        done = index->number > scp->limit->number;
+        double delta = scp->step.number;
+        index->number += delta;
+        
+        if (delta < 0) {
+            done = index->number < scp->limit.number;
+        } else {
+            done = index->number > scp->limit.number;
+        }
     }
     
     if (!done) {
-        runtime_set_next_statement(rt, scp->loop_top);
+        *loop_top = scp->loop_top;
     } else {
         scope_stack_pop(stk);
     }
+    
+    return 1;
 }
@@ -2,9 +2,13 @@
 #define for_h
 
 typedef struct parser parser;
+typedef struct runtime runtime;
 typedef struct statement statement;
+typedef struct value value;
 
 extern void for_parse(parser *prs, statement *stmt);
 extern void next_parse(parser *prs, statement *stmt);
+extern int for_enter(runtime *rt, int slot, const char *id, value *start, value *limit, value *step, statement *loop_top);
+extern int for_next(runtime *rt, int slot, const char *id, statement **loop_top);
 
 #endif /* for_h */
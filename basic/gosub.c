@@ -1,26 +1,26 @@
+#include "compile.h"
 #include "expression.h"
 #include "gosub.h"
 #include "parser.h"
+#include "program.h"
 #include "runtime.h"
-#include "safemem.h"
 #include "scope.h"
 #include "statement.h"
 #include "value.h"
 
 typedef struct gosub_node gosub_node;
-typedef struct gosub_scope gosub_scope;
 typedef struct return_node return_node;
 
-static void gosub_free(statement_body *body);
 static void gosub_execute(statement_body *body, runtime *rt);
-static void gosub_scope_free(scope *scope);
-static void return_free(statement_body *body);
+static void gosub_compile(statement_body *body, compiler *cmp);
+static void gosub_link(statement_body *body, linker *lnk);
 static void return_execute(statement_body *body, runtime *rt);
+static void return_compile(statement_body *body, compiler *cmp);
 
 struct gosub_node
 {
     statement_body body;
-    int target;
+    line_ref target;
 };
 
 struct return_node
@@ -28,26 +28,20 @@ struct return_node
     statement_body body;
 };
 
-struct gosub_scope
-{
-    scope scope;
-    statement *return_stmt;
-};
-
 /* Parse a GOSUB statement
  */
 void gosub_parse(parser *prs, statement *stmt)
 {
-    gosub_node *gsu = safe_calloc(1, sizeof(gosub_node));
+    gosub_node *gsu = parser_alloc_node(prs, sizeof(gosub_node));
     
-    if ((gsu->target = parser_expect_line_no(prs, 1)) == -1 ||
+    if ((gsu->target.line = parser_expect_line_no(prs, 1)) == -1 ||
         !parser_expect_end_of_line(prs)) {
-        gosub_free(&gsu->body);
         return;
     }
     
-    gsu->body.free = &gosub_free;
     gsu->body.execute = &gosub_execute;
+    gsu->body.compile = &gosub_compile;
+    gsu->body.link = &gosub_link;
 
     stmt->body = &gsu->body;
 }
@@ -56,57 +50,85 @@ void gosub_parse(parser *prs, statement *stmt)
  */
 void return_parse(parser *prs, statement *stmt)
 {
-    return_node *rtn = safe_calloc(1, sizeof(return_node));
+    return_node *rtn = parser_alloc_node(prs, sizeof(return_node));
     
     if (!parser_expect_end_of_line(prs)) {
-        return_free(&rtn->body);
         return;
     }
     
-    rtn->body.free = &return_free;
     rtn->body.execute = &return_execute;
+    rtn->body.compile = &return_compile;
 
     stmt->body = &rtn->body;
 }
 
-/* Free a GOSUB node
+/* Execute gosub
  */
-void gosub_free(statement_body *body)
+void gosub_execute(statement_body *body, runtime *rt)
 {
-    free(body);
+    gosub_node *gsu = (gosub_node *)body;
+    
+    if (gosub_call(rt, runtime_next_statement(rt))) {
+        runtime_set_next_statement(rt, gsu->target.target);
+    }
 }
 
-/* Execute gosub
+/* Compile gosub
  */
-void gosub_execute(statement_body *body, runtime *rt)
+void gosub_compile(statement_body *body, compiler *cmp)
 {
     gosub_node *gsu = (gosub_node *)body;
-    gosub_scope *scope = safe_calloc(1, sizeof(gosub_scope));
-    scope->scope.type = SCOPE_GOSUB;
-    scope->scope.free = &gosub_scope_free;
-    scope->return_stmt = runtime_next_statement(rt);
-    
-    scope_stack_push(runtime_scope_stack(rt), &scope->scope);
-    runtime_goto(rt, gsu->target);
+    compiler_emit_goto(cmp, OP_GOSUB, gsu->target.target);
 }
 
-/* Free a gosub scope node
+/* Link gosub
  */
-void gosub_scope_free(scope *scope)
+void gosub_link(statement_body *body, linker *lnk)
 {
-    free(scope);
+    gosub_node *gsu = (gosub_node *)body;
+    linker_resolve(lnk, &gsu->target);
 }
 
-/* Free a RETURN node
+/* Push the scope for a subroutine call which will return to
+ * return_stmt. The caller is responsible for the jump.
+ * Returns 0 and sets a runtime error if the stack is full.
  */
-void return_free(statement_body *body)
+int gosub_call(runtime *rt, statement *return_stmt)
 {
-    free(body);
+    scope *scp = scope_stack_push(runtime_scope_stack(rt), SCOPE_GOSUB);
+    
+    if (scp == NULL) {
+        runtime_set_error(rt, "STACK OVERFLOW");
+        return 0;
+    }
+    
+    scp->u.gosub.return_stmt = return_stmt;
+    return 1;
 }
 
 /* execute return
  */
 void return_execute(statement_body *body, runtime *rt)
+{
+    statement *return_stmt = NULL;
+    
+    if (gosub_return(rt, &return_stmt)) {
+        runtime_set_next_statement(rt, return_stmt);
+    }
+}
+
+/* compile return
+ */
+void return_compile(statement_body *body, compiler *cmp)
+{
+    compiler_emit(cmp, OP_RETURN);
+}
+
+/* Pop the innermost subroutine call. On success, returns 1 and sets
+ * return_stmt to the statement to continue with. Otherwise sets a
+ * runtime error and returns 0.
+ */
+int gosub_return(runtime *rt, statement **return_stmt)
 {
     scope_stack *stk = runtime_scope_stack(rt);
     
@@ -120,14 +142,16 @@ void return_execute(statement_body *body, runtime *rt)
      *
      */
     scope_stack_pop_until(stk, SCOPE_GOSUB);
-    if (stk->top == NULL) {
+    
+    scope *scp = scope_stack_top(stk);
+    if (scp == NULL) {
         runtime_set_error(rt, "RETURN WITHOUT GOSUB");
-        return;
+        return 0;
     }
     
-    gosub_scope *scp = (gosub_scope *)stk->top;
-    
-    runtime_set_next_statement(rt, scp->return_stmt);
+    *return_stmt = scp->u.gosub.return_stmt;
     scope_stack_pop(stk);
+    
+    return 1;
 }
 
@@ -2,9 +2,12 @@
 #define gosub_h
 
 typedef struct parser parser;
+typedef struct runtime runtime;
 typedef struct statement statement;
 
 extern void gosub_parse(parser *prs, statement *stmt);
 extern void return_parse(parser *prs, statement *stmt);
+extern int gosub_call(runtime *rt, statement *return_stmt);
+extern int gosub_return(runtime *rt, statement **return_stmt);
 
 #endif /* gosub_h */
@@ -1,6 +1,8 @@
+#include "compile.h"
 #include "expression.h"
 #include "goto.h"
 #include "parser.h"
+#include "program.h"
 #include "runtime.h"
 #include "safemem.h"
 #include "statement.h"
@@ -11,26 +13,27 @@ typedef struct goto_node goto_node;
 struct goto_node
 {
     statement_body body;
-    int target;
+    line_ref target;
 };
 
 static void goto_execute(statement_body *body, runtime *rt);
-static void goto_free(statement_body *body);
+static void goto_compile(statement_body *body, compiler *cmp);
+static void goto_link(statement_body *body, linker *lnk);
 
 /* Parse the goto statement
  */
 void goto_parse(parser *prs, statement *stmt)
 {
-    goto_node *gto = safe_calloc(1, sizeof(goto_node));
+    goto_node *gto = parser_alloc_node(prs, sizeof(goto_node));
     
-    if ((gto->target = parser_expect_line_no(prs, 1)) == -1 ||
+    if ((gto->target.line = parser_expect_line_no(prs, 1)) == -1 ||
         !parser_expect_end_of_line(prs)) {
-        goto_free(&gto->body);
         return;
     }
     
-    gto->body.free = &goto_free;
     gto->body.execute = &goto_execute;
+    gto->body.compile = &goto_compile;
+    gto->body.link = &goto_link;
 
     stmt->body = &gto->body;
 }
@@ -40,14 +43,23 @@ void goto_parse(parser *prs, statement *stmt)
 void goto_execute(statement_body *body, runtime *rt)
 {
     goto_node *gto = (goto_node*)body;
-    runtime_goto(rt, gto->target);
+    runtime_set_next_statement(rt, gto->target.target);
 }
 
-/* free a goto node
+/* compile a goto node
  */
-void goto_free(statement_body *body)
+void goto_compile(statement_body *body, compiler *cmp)
 {
-    free(body);
+    goto_node *gto = (goto_node*)body;
+    compiler_emit_goto(cmp, OP_GOTO, gto->target.target);
+}
+
+/* link a goto node
+ */
+void goto_link(statement_body *body, linker *lnk)
+{
+    goto_node *gto = (goto_node*)body;
+    linker_resolve(lnk, &gto->target);
 }
 
 
@@ -1,6 +1,8 @@
+#include "compile.h"
 #include "expression.h"
 #include "if.h"
 #include "parser.h"
+#include "program.h"
 #include "runtime.h"
 #include "safemem.h"
 #include "statement.h"
@@ -12,32 +14,40 @@ struct if_node
 {
     statement_body body;
     expression *exp;
-    int then_target;
-    int else_target;
+    line_ref then_target;
+    line_ref else_target;
 };
 
 static void if_execute(statement_body *body, runtime *rt);
 static void if_free(statement_body *body);
+static void if_compile(statement_body *body, compiler *cmp);
+static void if_link(statement_body *body, linker *lnk);
 
 /* Parse the if statement
  */
 void if_parse(parser *prs, statement *stmt)
 {
-    if_node *ifn = safe_calloc(1, sizeof(if_node));
+    if_node *ifn = parser_alloc_node(prs, sizeof(if_node));
     
-    ifn->then_target = -1;
-    ifn->else_target = -1;
+    ifn->then_target.line = -1;
+    ifn->else_target.line = -1;
     
     if ((ifn->exp = expression_parse(prs)) == NULL ||
         !parser_expect_id(prs, "THEN") ||
-        (ifn->then_target = parser_expect_line_no(prs, 1)) == -1) {
+        (ifn->then_target.line = parser_expect_line_no(prs, 1)) == -1) {
+        if_free(&ifn->body);
+        return;
+    }
+    
+    if (expression_type(ifn->exp) != TYPE_BOOLEAN) {
+        parser_set_error(prs, "IF EXPRESSION NOT COMPARISON");
         if_free(&ifn->body);
         return;
     }
     
     if (prs->token_type != TOK_END) {
         if (!parser_expect_id(prs, "ELSE") ||
-            (ifn->else_target = parser_expect_line_no(prs, 1)) == -1) {
+            (ifn->else_target.line = parser_expect_line_no(prs, 1)) == -1) {
             if_free(&ifn->body);
             return;
         }
@@ -50,6 +60,8 @@ void if_parse(parser *prs, statement *stmt)
     
     ifn->body.free = &if_free;
     ifn->body.execute = &if_execute;
+    ifn->body.compile = &if_compile;
+    ifn->body.link = &if_link;
 
     stmt->body = &ifn->body;
 }
@@ -60,29 +72,54 @@ void if_execute(statement_body *body, runtime *rt)
 {
     if_node *ifn = (if_node*)body;
     
-    value *v = expression_evaluate(ifn->exp, rt);
-    if (v == NULL || v->type != TYPE_BOOLEAN) {
-        runtime_set_error(rt, "IF EXPRESSION NOT COMPARISON");
-    } else if (v->boolean) {
-        runtime_goto(rt, ifn->then_target);
-    } else if (ifn->else_target != -1) {
-        runtime_goto(rt, ifn->else_target);
+    value v;
+    
+    if (!expression_evaluate(ifn->exp, rt, &v)) {
+        return;
     }
     
-    value_free(v);
+    if (v.boolean) {
+        runtime_set_next_statement(rt, ifn->then_target.target);
+    } else if (ifn->else_target.line != -1) {
+        runtime_set_next_statement(rt, ifn->else_target.target);
+    }
 }
 
-/* free an if node
+/* compile an if node
  */
-void if_free(statement_body *body)
+void if_compile(statement_body *body, compiler *cmp)
 {
-    if_node *ifn = (if_node *)body;
+    if_node *ifn = (if_node*)body;
+    
+    expression_compile(ifn->exp, cmp);
+    int branch = compiler_emit_branch(cmp, OP_JUMP_FALSE);
+    compiler_emit_goto(cmp, OP_GOTO, ifn->then_target.target);
+    compiler_patch_branch(cmp, branch);
+    
+    if (ifn->else_target.line != -1) {
+        compiler_emit_goto(cmp, OP_GOTO, ifn->else_target.target);
+    }
+}
+
+/* link an if node
+ */
+void if_link(statement_body *body, linker *lnk)
+{
+    if_node *ifn = (if_node*)body;
     
-    if (ifn) {
-        expression_free(ifn->exp);
+    linker_resolve(lnk, &ifn->then_target);
+    if (ifn->else_target.line != -1) {
+        linker_resolve(lnk, &ifn->else_target);
     }
+}
 
-    free(ifn);
+/* free an if node's expression
+ */
+void if_free(statement_body *body)
+{
+    if_node *ifn = (if_node *)body;
+    
+    expression_free(ifn->exp);
 }
 
 
@@ -2,12 +2,14 @@
 
 #include "expression.h"
 #include "input.h"
+#include "numparse.h"
 #include "output.h"
 #include "parser.h"
 #include "runtime.h"
 #include "safemem.h"
 #include "statement.h"
 #include "stringutil.h"
+#include "strobj.h"
 #include "value.h"
 
 typedef struct input_node input_node;
@@ -17,38 +19,37 @@ struct input_node
     statement_body body;
     char *prompt;
     char *varname;
+    int slot;
 };
 
 static void input_execute(statement_body *body, runtime *rt);
-static void input_free(statement_body *body);
+static int parse_number(const char *input, valuetype type, value *val);
 
 /* Parse the input statement
  */
 void input_parse(parser *prs, statement *stmt)
 {
-    input_node *inp = safe_calloc(1, sizeof(input_node));
+    input_node *inp = parser_alloc_node(prs, sizeof(input_node));
     
     /* the prompt is optional 
      */
     if (prs->token_type == TOK_STRING) {
-        inp->prompt = safe_strdup(parser_extract_token_text(prs));
+        inp->prompt = parser_keep_token_text(prs);
         strunquote(inp->prompt);
         parse_next_token(prs);
         
         if (!parser_expect_operator(prs, TOK_COMMA)) {
-            input_free(&inp->body);
             return;
         }
     }
     
     if ((inp->varname = parser_expect_var(prs)) == NULL) {
-        input_free(&inp->body);
         return;
     }
+    inp->slot = runtime_var_slot(inp->varname);
     
     inp->body.execute = &input_execute;
-    inp->body.free = &input_free;
-
+    
     stmt->body = &inp->body;
 }
 
@@ -58,6 +59,7 @@ void input_execute(statement_body *body, runtime *rt)
 {
     input_node *inp = (input_node*)body;
     
+    output_flush(runtime_get_output(rt));
     printf("%s? ", inp->prompt ? inp->prompt : "");
     
     char input[200];
@@ -84,44 +86,68 @@ void input_execute(statement_body *body, runtime *rt)
         }
         input[len] = '\0';
         
-        /* TODO factor this check out somewhere
-         * or even better store variables as their var index when parsing
-         */
-        value *value = NULL;
-        if (inp->varname[strlen(inp->varname) - 1] == '$') {
-            value = value_alloc_string(input, VAL_COPY);
+        value val;
+        valuetype type = runtime_var_type(inp->slot);
+        if (type == TYPE_STRING) {
+            value_set_string(&val, strobj_from_cstr(input));
         } else if (eof) {
             /* If we've hit EOF we'll never get a valid number 
              */
-            value = value_alloc_number(0);
-        } else {
-            double num = 0.0;
-            
-            if (sscanf(input, "%lf", &num) == 0) {
-                printf("INVALID INPUT\n");
-                continue;
+            if (type == TYPE_INTEGER) {
+                value_set_integer(&val, 0);
+            } else {
+                value_set_number(&val, 0);
             }
-            
-            value = value_alloc_number(num);
+        } else if (!parse_number(input, type, &val)) {
+            printf("INVALID INPUT\n");
+            continue;
         }
         
-        runtime_setvar(rt, inp->varname, value);
+        runtime_setvar(rt, inp->slot, &val);
         break;
     }
 }
 
-/* free an input node
+/* Parse a number typed in for a variable of the given type. It may
+ * have a sign and leading spaces, and anything after it is ignored. A
+ * blank line is zero. Returns 0 if there's no number.
  */
-void input_free(statement_body *body)
+int parse_number(const char *input, valuetype type, value *val)
 {
-    input_node *inp = (input_node*)body;
+    const char *p = input + strspn(input, " \t");
     
-    if (inp) {
-        free(inp->prompt);
-        free(inp->varname);
+    if (*p == '\0') {
+        if (type == TYPE_INTEGER) {
+            value_set_integer(val, 0);
+        } else {
+            value_set_number(val, 0);
+        }
+        return 1;
     }
-
-    free(inp);
+    
+    if (type == TYPE_INTEGER) {
+        int64_t num;
+        
+        if (numparse_integer(p, &num) <= 0) {
+            return 0;
+        }
+        value_set_integer(val, num);
+        return 1;
+    }
+    
+    int negative = *p == '-';
+    double num;
+    
+    if (*p == '+' || *p == '-') {
+        p++;
+    }
+    
+    if (numparse_double(p, &num) == 0) {
+        return 0;
+    }
+    value_set_number(val, negative ? -num : num);
+    
+    return 1;
 }
 
 
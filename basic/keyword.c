@@ -18,6 +18,7 @@
 #include "run.h"
 #include "safemem.h"
 #include "save.h"
+#include "stats.h"
 #include "stringutil.h"
 
 #define MAX_ID 10
@@ -40,6 +41,7 @@ static keyword keywords[] =
     { "RUN", KWFL_OK_IN_REPL, &run_parse },
     { "RETURN", KWFL_OK_IN_STMT, &return_parse },
     { "SAVE", KWFL_OK_IN_REPL, &save_parse },
+    { "STATS", KWFL_OK_IN_REPL, &stats_parse },
 
     { NULL, 0 }
 };
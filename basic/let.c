@@ -1,9 +1,13 @@
+#include "compile.h"
 #include "expression.h"
 #include "let.h"
 #include "parser.h"
 #include "runtime.h"
 #include "safemem.h"
 #include "statement.h"
+#include "strobj.h"
+#include "value.h"
+#include "vartable.h"
 
 typedef struct let_node let_node;
 
@@ -11,30 +15,32 @@ struct let_node
 {
     statement_body body;
     char *id;
+    int slot;
     expression *exp;
+    int append;
 };
 
 static void let_execute(statement_body *body, runtime *rt);
 static void let_free(statement_body *body);
+static void let_compile(statement_body *body, compiler *cmp);
 
 /* Parse the let statement
  */
 void let_parse(parser *prs, statement *stmt)
 {
-    let_node *let = safe_calloc(1, sizeof(let_node));
+    let_node *let = parser_alloc_node(prs, sizeof(let_node));
     
     if (prs->token_type != TOK_IDENTIFIER) {
-        let_free(&let->body);
         parser_set_error(prs, "IDENTIFIER EXPECTED");
         return;
     }
     
-    let->id = parser_extract_token_text(prs);
+    let->id = parser_keep_token_text(prs);
+    let->slot = runtime_var_slot(let->id);
     
     parse_next_token(prs);
     
     if (prs->token_type != TOK_EQUALS) {
-        let_free(&let->body);
         parser_set_error(prs, "EQUALS EXPECTED");
         return;
     }
@@ -43,12 +49,25 @@ void let_parse(parser *prs, statement *stmt)
     
     let->exp = expression_parse(prs);
     if (let->exp == NULL) {
+        return;
+    }
+    
+    if (!expression_convert(let->exp, runtime_var_type(let->slot))) {
+        parser_set_error(prs, "CANNOT ASSIGN %s TO %s", value_describe_type(expression_type(let->exp)), let->id);
         let_free(&let->body);
         return;
     }
     
+    /* A$ = A$ + X$ is how programs build strings up, so it appends to
+     * the variable's string instead of copying it every time
+     */
+    if (runtime_var_type(let->slot) == TYPE_STRING) {
+        let->append = expression_strip_append(let->exp, let->slot);
+    }
+    
     let->body.execute = &let_execute;
     let->body.free = &let_free;
+    let->body.compile = &let_compile;
     
     stmt->body = &let->body;
     
@@ -59,25 +78,43 @@ void let_parse(parser *prs, statement *stmt)
 void let_execute(statement_body *body, runtime *rt)
 {
     let_node *let = (let_node *)body;
-    value *val = expression_evaluate(let->exp, rt);
+    value val;
     
-    if (val) {
-        runtime_setvar(rt, let->id, val);
+    if (!expression_evaluate(let->exp, rt, &val)) {
+        return;
+    }
+    
+    if (!let->append) {
+        runtime_setvar(rt, let->slot, &val);
+        return;
     }
+    
+    varcell *var = vartable_cell(runtime_vars(rt), let->slot);
+    if (var == NULL) {
+        runtime_set_error(rt, "VARIABLE %s IS NOT DEFINED", let->id);
+    } else {
+        var->string = strobj_append(var->string, val.string);
+    }
+    value_clear(&val);
 }
 
-/* free a let node
+/* compile a let node
  */
-void let_free(statement_body *body)
+void let_compile(statement_body *body, compiler *cmp)
 {
     let_node *let = (let_node *)body;
     
-    if (let) {
-        free(let->id);
-        expression_free(let->exp);
-    }
+    expression_compile(let->exp, cmp);
+    compiler_emit_var(cmp, let->append ? OP_APPEND : OP_STORE, let->slot, let->id);
+}
 
-    free(let);
+/* free a let node's expression
+ */
+void let_free(statement_body *body)
+{
+    let_node *let = (let_node *)body;
+    
+    expression_free(let->exp);
 }
 
 
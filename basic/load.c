@@ -20,22 +20,19 @@ struct load_node
 };
 
 static void load_execute(statement_body *body, runtime *rt);
-static void load_free(statement_body *body);
 
 /* Parse the load statement
  */
 void load_parse(parser *prs, statement *stmt)
 {
-    load_node *load = safe_calloc(1, sizeof(load_node));
+    load_node *load = parser_alloc_node(prs, sizeof(load_node));
     
     if ((load->filename = parser_expect_filename(prs)) == NULL ||
         !parser_expect_end_of_line(prs)) {
-        load_free(&load->body);
         return;
     }
     
     load->parser = prs;
-    load->body.free = &load_free;
     load->body.execute = &load_execute;
 
     stmt->body = &load->body;
@@ -64,16 +61,4 @@ void load_execute(statement_body *body, runtime *rt)
     }
 }
 
-/* free a load node
- */
-void load_free(statement_body *body)
-{
-    load_node *load = (load_node*)body;
-    if (load) {
-        free(load->filename);
-    }
-    
-    free(body);
-}
-
 
@@ -0,0 +1,29 @@
+10 REM
+20 REM LONG RUNNING LOOP. MEMORY USE SHOULD STAY FLAT NO MATTER
+30 REM HOW BIG N IS; MAKE RSS IN BENCH RUNS THIS AT TWO SIZES OF N.
+40 REM
+50 LET N = 1000000
+60 LET A$ = "ABC"
+70 LET C$ = ""
+80 LET T = 0
+90 LET I = 0
+100 LET I = I + 1
+110 LET B$ = A$ + "DEF" + A$
+120 IF B$ < A$ THEN 900
+130 LET T = T + ABS(-I) / N
+140 GOSUB 500
+150 REM LEAVE THE LOOP EARLY, SO THE NEXT FOR J REPLACES IT
+160 FOR J = 1 TO 10
+170 IF J = 3 THEN 190
+180 NEXT J
+190 IF I < N THEN 100
+200 PRINT "DONE "; T; " "; C$
+210 GOTO 1000
+500 LET C$ = B$ + C$
+510 LET C$ = A$
+520 FOR K = 1 TO 10
+530 IF K = 5 THEN 550
+540 NEXT K
+550 RETURN
+900 PRINT "BAD COMPARISON"
+1000 REM
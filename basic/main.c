@@ -1,21 +1,82 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
+#include "counters.h"
+#include "output.h"
 #include "parser.h"
 #include "program.h"
 #include "runtime.h"
+#include "scope.h"
 #include "statement.h"
 #include "stringutil.h"
 
 static int run_program(const char *name);
 static int run_repl();
 
+/* --tree runs programs by walking the parse tree rather than compiling
+ * them, for comparison with the VM
+ */
+static int tree_walk = 0;
+
+/* --dump-folding prints each expression as it's parsed and again after
+ * its constant parts have been folded
+ */
+static int dump_folding = 0;
+
+/* --profile reports how often each line ran and how long it took
+ */
+static int profile = 0;
+
+/* --stats=json prints the runtime counters as JSON on stderr at exit
+ */
+static int stats_json = 0;
+
+/* --block-output writes output in large blocks when it isn't going to
+ * a terminal
+ */
+static int block_output = 0;
+
+/* --stack-depth=N limits how many GOSUB calls and FOR loops may be
+ * active at once
+ */
+static int stack_depth = SCOPE_DEFAULT_MAX_DEPTH;
+
 int main(int argc, const char * argv[])
 {
-    if (argc > 1) {
-        return run_program(argv[1]);
+    int arg = 1;
+    
+    for (; arg < argc && strncmp(argv[arg], "--", 2) == 0; arg++) {
+        if (strcmp(argv[arg], "--tree") == 0) {
+            tree_walk = 1;
+        } else if (strcmp(argv[arg], "--dump-folding") == 0) {
+            dump_folding = 1;
+        } else if (strcmp(argv[arg], "--profile") == 0) {
+            profile = 1;
+        } else if (strcmp(argv[arg], "--block-output") == 0) {
+            block_output = 1;
+        } else if (strcmp(argv[arg], "--stats=json") == 0) {
+            stats_json = 1;
+        } else if (strncmp(argv[arg], "--stack-depth=", 14) == 0) {
+            stack_depth = atoi(argv[arg] + 14);
+            if (stack_depth <= 0) {
+                fprintf(stderr, "invalid stack depth %s\n", argv[arg] + 14);
+                return 1;
+            }
+        } else {
+            fprintf(stderr, "unknown option %s\n", argv[arg]);
+            return 1;
+        }
+    }
+    
+    int status = arg < argc ? run_program(argv[arg]) : run_repl();
+    
+    if (stats_json) {
+        fflush(stdout);
+        counters_print_json(stderr);
     }
     
-    return run_repl();
+    return status;
 }
 
 int run_program(const char *name)
@@ -28,17 +89,27 @@ int run_program(const char *name)
 
     program *pgm = program_alloc();
     parser *prs = parser_alloc();
+    parser_set_dump_folding(prs, dump_folding);
 
-    if (parser_parse_file(prs, fp, pgm) == -1) {
+    int ok = parser_parse_file(prs, fp, pgm) != -1;
+    fclose(fp);
+    
+    if (ok) {
+        runtime *rt = runtime_alloc(pgm);
+        runtime_set_tree_walk(rt, tree_walk);
+        runtime_set_profile(rt, profile);
+        output_set_block_buffered(runtime_get_output(rt), block_output);
+        scope_stack_set_max_depth(runtime_scope_stack(rt), stack_depth);
+        runtime_run(rt);
+        runtime_free(rt);
+    } else {
         fprintf(stderr, "parse failed.\n");
-        return 1;
     }
-
-    runtime *rt = runtime_alloc(pgm);
-    runtime_run(rt);
-    runtime_free(rt);
     
-    return 0;
+    parser_free(prs);
+    program_free(pgm);
+    
+    return ok ? 0 : 1;
 }
 
 int run_repl()
@@ -50,6 +121,12 @@ int run_repl()
     runtime *rt = runtime_alloc(pgm);
     int ready = 1;
     
+    runtime_set_tree_walk(rt, tree_walk);
+    runtime_set_profile(rt, profile);
+    output_set_block_buffered(runtime_get_output(rt), block_output);
+    scope_stack_set_max_depth(runtime_scope_stack(rt), stack_depth);
+    parser_set_dump_folding(prs, dump_folding);
+    
     const char *readyfmt = "READY %D %T\n";
     
     while (1) {
@@ -69,11 +146,20 @@ int run_repl()
         }
         
         if (stmt != NULL) {
+            /* immediate statements aren't part of the program, so
+             * nothing else owns them
+             */
             runtime_execute_statement(rt, stmt);
+            output_flush(runtime_get_output(rt));
+            statement_free(stmt);
             ready++;
         }
     }
     
+    runtime_free(rt);
+    parser_free(prs);
+    program_free(pgm);
+    
     return 0;
 }
 
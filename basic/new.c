@@ -14,15 +14,13 @@ struct new_node
 };
 
 static void new_execute(statement_body *body, runtime *rt);
-static void new_free(statement_body *body);
 
 /* Parse the new statement
  */
 void new_parse(parser *prs, statement *stmt)
 {
-    new_node *newn = safe_calloc(1, sizeof(new_node));
+    new_node *newn = parser_alloc_node(prs, sizeof(new_node));
     newn->body.execute = &new_execute;
-    newn->body.free = &new_free;
     stmt->body = &newn->body;
 }
 
@@ -34,11 +32,4 @@ void new_execute(statement_body *body, runtime *rt)
     program_new(pgm);
 }
 
-/* free a new node
- */
-void new_free(statement_body *body)
-{
-    free(body);
-}
-
 
@@ -0,0 +1,458 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "numformat.h"
+
+/* Numbers are converted to the shortest string of decimal digits which
+ * reads back as the same double, using Grisu3 (Loitsch, "Printing
+ * Floating-Point Numbers Quickly and Accurately with Integers"). It
+ * works on 64-bit integers throughout, scaling the number by a cached
+ * power of ten so that all the digits can be generated from one
+ * product. For the few numbers where the rounding errors of that
+ * leave the shortest result in doubt, it says so, and the digits are
+ * found with snprintf and strtod instead.
+ */
+
+typedef struct diyfp diyfp;
+typedef struct cached_power cached_power;
+
+/* f * 2^e
+ */
+struct diyfp
+{
+    uint64_t f;
+    int e;
+};
+
+/* 10^k = f * 2^e
+ */
+struct cached_power
+{
+    uint64_t f;
+    int e;
+    int k;
+};
+
+/* The scaled number's binary exponent is kept in [ALPHA, -32], so that
+ * the integer part of it fits in 32 bits
+ */
+static const int ALPHA = -60;
+
+static const int CACHED_POWERS_MIN_EXP = -300;
+static const int CACHED_POWERS_STEP = 8;
+
+static const cached_power cached_powers[] =
+{
+    { 0xAB70FE17C79AC6CAULL, -1060, -300 },
+    { 0xFF77B1FCBEBCDC4FULL, -1034, -292 },
+    { 0xBE5691EF416BD60CULL, -1007, -284 },
+    { 0x8DD01FAD907FFC3CULL,  -980, -276 },
+    { 0xD3515C2831559A83ULL,  -954, -268 },
+    { 0x9D71AC8FADA6C9B5ULL,  -927, -260 },
+    { 0xEA9C227723EE8BCBULL,  -901, -252 },
+    { 0xAECC49914078536DULL,  -874, -244 },
+    { 0x823C12795DB6CE57ULL,  -847, -236 },
+    { 0xC21094364DFB5637ULL,  -821, -228 },
+    { 0x9096EA6F3848984FULL,  -794, -220 },
+    { 0xD77485CB25823AC7ULL,  -768, -212 },
+    { 0xA086CFCD97BF97F4ULL,  -741, -204 },
+    { 0xEF340A98172AACE5ULL,  -715, -196 },
+    { 0xB23867FB2A35B28EULL,  -688, -188 },
+    { 0x84C8D4DFD2C63F3BULL,  -661, -180 },
+    { 0xC5DD44271AD3CDBAULL,  -635, -172 },
+    { 0x936B9FCEBB25C996ULL,  -608, -164 },
+    { 0xDBAC6C247D62A584ULL,  -582, -156 },
+    { 0xA3AB66580D5FDAF6ULL,  -555, -148 },
+    { 0xF3E2F893DEC3F126ULL,  -529, -140 },
+    { 0xB5B5ADA8AAFF80B8ULL,  -502, -132 },
+    { 0x87625F056C7C4A8BULL,  -475, -124 },
+    { 0xC9BCFF6034C13053ULL,  -449, -116 },
+    { 0x964E858C91BA2655ULL,  -422, -108 },
+    { 0xDFF9772470297EBDULL,  -396, -100 },
+    { 0xA6DFBD9FB8E5B88FULL,  -369,  -92 },
+    { 0xF8A95FCF88747D94ULL,  -343,  -84 },
+    { 0xB94470938FA89BCFULL,  -316,  -76 },
+    { 0x8A08F0F8BF0F156BULL,  -289,  -68 },
+    { 0xCDB02555653131B6ULL,  -263,  -60 },
+    { 0x993FE2C6D07B7FACULL,  -236,  -52 },
+    { 0xE45C10C42A2B3B06ULL,  -210,  -44 },
+    { 0xAA242499697392D3ULL,  -183,  -36 },
+    { 0xFD87B5F28300CA0EULL,  -157,  -28 },
+    { 0xBCE5086492111AEBULL,  -130,  -20 },
+    { 0x8CBCCC096F5088CCULL,  -103,  -12 },
+    { 0xD1B71758E219652CULL,   -77,   -4 },
+    { 0x9C40000000000000ULL,   -50,    4 },
+    { 0xE8D4A51000000000ULL,   -24,   12 },
+    { 0xAD78EBC5AC620000ULL,     3,   20 },
+    { 0x813F3978F8940984ULL,    30,   28 },
+    { 0xC097CE7BC90715B3ULL,    56,   36 },
+    { 0x8F7E32CE7BEA5C70ULL,    83,   44 },
+    { 0xD5D238A4ABE98068ULL,   109,   52 },
+    { 0x9F4F2726179A2245ULL,   136,   60 },
+    { 0xED63A231D4C4FB27ULL,   162,   68 },
+    { 0xB0DE65388CC8ADA8ULL,   189,   76 },
+    { 0x83C7088E1AAB65DBULL,   216,   84 },
+    { 0xC45D1DF942711D9AULL,   242,   92 },
+    { 0x924D692CA61BE758ULL,   269,  100 },
+    { 0xDA01EE641A708DEAULL,   295,  108 },
+    { 0xA26DA3999AEF774AULL,   322,  116 },
+    { 0xF209787BB47D6B85ULL,   348,  124 },
+    { 0xB454E4A179DD1877ULL,   375,  132 },
+    { 0x865B86925B9BC5C2ULL,   402,  140 },
+    { 0xC83553C5C8965D3DULL,   428,  148 },
+    { 0x952AB45CFA97A0B3ULL,   455,  156 },
+    { 0xDE469FBD99A05FE3ULL,   481,  164 },
+    { 0xA59BC234DB398C25ULL,   508,  172 },
+    { 0xF6C69A72A3989F5CULL,   534,  180 },
+    { 0xB7DCBF5354E9BECEULL,   561,  188 },
+    { 0x88FCF317F22241E2ULL,   588,  196 },
+    { 0xCC20CE9BD35C78A5ULL,   614,  204 },
+    { 0x98165AF37B2153DFULL,   641,  212 },
+    { 0xE2A0B5DC971F303AULL,   667,  220 },
+    { 0xA8D9D1535CE3B396ULL,   694,  228 },
+    { 0xFB9B7CD9A4A7443CULL,   720,  236 },
+    { 0xBB764C4CA7A44410ULL,   747,  244 },
+    { 0x8BAB8EEFB6409C1AULL,   774,  252 },
+    { 0xD01FEF10A657842CULL,   800,  260 },
+    { 0x9B10A4E5E9913129ULL,   827,  268 },
+    { 0xE7109BFBA19C0C9DULL,   853,  276 },
+    { 0xAC2820D9623BF429ULL,   880,  284 },
+    { 0x80444B5E7AA7CF85ULL,   907,  292 },
+    { 0xBF21E44003ACDD2DULL,   933,  300 },
+    { 0x8E679C2F5E44FF8FULL,   960,  308 },
+    { 0xD433179D9C8CB841ULL,   986,  316 },
+    { 0x9E19DB92B4E31BA9ULL,  1013,  324 },
+};
+
+/* Beyond these decimal exponents numbers are printed as d.dddE+nn
+ */
+static const int FIXED_MIN_EXP = -5;
+static const int FIXED_MAX_EXP = 16;
+
+static diyfp diyfp_mul(diyfp x, diyfp y);
+static diyfp diyfp_normalize(diyfp x);
+static void compute_boundaries(double number, diyfp *w, diyfp *minus, diyfp *plus);
+static cached_power find_cached_power(int e);
+static int grisu3(char *digits, int *len, int *dec_exp, double number);
+static int digit_gen(char *digits, int *len, int *dec_exp, diyfp low, diyfp w, diyfp high);
+static int round_weed(char *digits, int len, uint64_t dist_high_w, uint64_t unsafe, uint64_t rest, uint64_t ten_k, uint64_t unit);
+static int shortest_slow(char *digits, int *dec_exp, double number);
+static int format_digits(char *buf, const char *digits, int len, int dec_exp);
+
+/* Format a number as the shortest decimal which converts back to
+ * exactly the same double. Very large and very small numbers are
+ * written with an exponent, as 1.5E+20 or 2E-07. buf must hold at
+ * least NUMFORMAT_SIZE characters. Returns the length of the string.
+ */
+int numformat_double(double number, char *buf)
+{
+    char *p = buf;
+    
+    if (number != number) {
+        strcpy(buf, "NAN");
+        return 3;
+    }
+    
+    if (number < 0) {
+        *p++ = '-';
+        number = -number;
+    }
+    
+    if (number == 0) {
+        /* no negative zero */
+        strcpy(buf, "0");
+        return 1;
+    }
+    
+    if (number > 1.7976931348623157e308) {
+        strcpy(p, "INF");
+        return (int)(p - buf) + 3;
+    }
+    
+    char digits[18];
+    int len;
+    int dec_exp;
+    if (!grisu3(digits, &len, &dec_exp, number)) {
+        len = shortest_slow(digits, &dec_exp, number);
+    }
+    
+    return (int)(p - buf) + format_digits(p, digits, len, dec_exp);
+}
+
+/* Lay out the digits of a number whose value is digits * 10^dec_exp
+ */
+int format_digits(char *buf, const char *digits, int len, int dec_exp)
+{
+    /* the number is 0.digits * 10^point */
+    int point = len + dec_exp;
+    char *p = buf;
+    
+    if (point > FIXED_MIN_EXP && point <= FIXED_MAX_EXP) {
+        if (point <= 0) {
+            /* 0.000ddd */
+            *p++ = '0';
+            *p++ = '.';
+            memset(p, '0', -point);
+            p += -point;
+            memcpy(p, digits, len);
+            p += len;
+        } else if (point >= len) {
+            /* ddd000 */
+            memcpy(p, digits, len);
+            p += len;
+            memset(p, '0', point - len);
+            p += point - len;
+        } else {
+            /* ddd.ddd */
+            memcpy(p, digits, point);
+            p += point;
+            *p++ = '.';
+            memcpy(p, digits + point, len - point);
+            p += len - point;
+        }
+        
+        *p = '\0';
+        return (int)(p - buf);
+    }
+    
+    /* d.dddE+nn */
+    *p++ = digits[0];
+    if (len > 1) {
+        *p++ = '.';
+        memcpy(p, digits + 1, len - 1);
+        p += len - 1;
+    }
+    
+    int exp = point - 1;
+    *p++ = 'E';
+    if (exp < 0) {
+        *p++ = '-';
+        exp = -exp;
+    } else {
+        *p++ = '+';
+    }
+    
+    if (exp >= 100) {
+        *p++ = '0' + exp / 100;
+        exp %= 100;
+    }
+    *p++ = '0' + exp / 10;
+    *p++ = '0' + exp % 10;
+    
+    *p = '\0';
+    return (int)(p - buf);
+}
+
+/* Generate the shortest digits of a positive, finite number, such that
+ * the number is digits * 10^dec_exp. Returns 0 if the result can't be
+ * guaranteed to be the shortest and correct.
+ */
+int grisu3(char *digits, int *len, int *dec_exp, double number)
+{
+    diyfp w, minus, plus;
+    
+    /* any number between minus and plus rounds to number */
+    compute_boundaries(number, &w, &minus, &plus);
+    
+    cached_power cached = find_cached_power(plus.e);
+    diyfp c = { cached.f, cached.e };
+    
+    w = diyfp_mul(w, c);
+    minus = diyfp_mul(minus, c);
+    plus = diyfp_mul(plus, c);
+    
+    *len = 0;
+    *dec_exp = -cached.k;
+    return digit_gen(digits, len, dec_exp, minus, w, plus);
+}
+
+/* Find the digits of the shortest number in the interval the scaled
+ * boundaries describe. Each product may be out by one unit, so digits
+ * are generated from just above the interval, and accepted only if
+ * they're in it whatever the errors were.
+ */
+int digit_gen(char *digits, int *len, int *dec_exp, diyfp low, diyfp w, diyfp high)
+{
+    uint64_t unit = 1;
+    uint64_t too_low = low.f - unit;
+    uint64_t too_high = high.f + unit;
+    uint64_t unsafe = too_high - too_low;
+    
+    /* split too_high into an integer part p1 and a fraction p2 */
+    int shift = -w.e;
+    uint64_t one = 1ULL << shift;
+    uint32_t p1 = (uint32_t)(too_high >> shift);
+    uint64_t p2 = too_high & (one - 1);
+    
+    uint32_t pow10 = 1;
+    int n = 1;
+    while (n < 10 && pow10 * 10 <= p1) {
+        pow10 *= 10;
+        n++;
+    }
+    
+    while (n > 0) {
+        digits[(*len)++] = '0' + p1 / pow10;
+        p1 %= pow10;
+        n--;
+        
+        uint64_t rest = ((uint64_t)p1 << shift) + p2;
+        if (rest < unsafe) {
+            *dec_exp += n;
+            return round_weed(digits, *len, too_high - w.f, unsafe, rest, (uint64_t)pow10 << shift, unit);
+        }
+        
+        pow10 /= 10;
+    }
+    
+    /* the integer part wasn't enough, so generate fraction digits */
+    while (1) {
+        p2 *= 10;
+        unit *= 10;
+        unsafe *= 10;
+        
+        digits[(*len)++] = '0' + (char)(p2 >> shift);
+        p2 &= one - 1;
+        (*dec_exp)--;
+        
+        if (p2 < unsafe) {
+            return round_weed(digits, *len, (too_high - w.f) * unit, unsafe, p2, one, unit);
+        }
+    }
+}
+
+/* The digits are too high by rest. Move the last digit down while
+ * that brings the result closer to w and keeps it in the interval.
+ * Returns 0 if the errors in the scaled values mean another result
+ * could be closer, or the result could be outside the interval.
+ */
+int round_weed(char *digits, int len, uint64_t dist_high_w, uint64_t unsafe, uint64_t rest, uint64_t ten_k, uint64_t unit)
+{
+    uint64_t small_dist = dist_high_w - unit;
+    uint64_t big_dist = dist_high_w + unit;
+    
+    while (rest < small_dist && unsafe - rest >= ten_k &&
+        (rest + ten_k < small_dist || small_dist - rest >= rest + ten_k - small_dist)) {
+        digits[len - 1]--;
+        rest += ten_k;
+    }
+    
+    if (rest < big_dist && unsafe - rest >= ten_k &&
+        (rest + ten_k < big_dist || big_dist - rest > rest + ten_k - big_dist)) {
+        return 0;
+    }
+    
+    return 2 * unit <= rest && rest <= unsafe - 4 * unit;
+}
+
+/* Find the shortest digits by asking snprintf for more and more of
+ * them until they read back as the number. snprintf rounds correctly,
+ * so the first that does is the shortest.
+ */
+int shortest_slow(char *digits, int *dec_exp, double number)
+{
+    char buf[NUMFORMAT_SIZE];
+    
+    for (int precision = 1; precision <= 17; precision++) {
+        snprintf(buf, sizeof(buf), "%.*e", precision - 1, number);
+        if (strtod(buf, NULL) == number || precision == 17) {
+            break;
+        }
+    }
+    
+    /* buf is d.dddde[+-]nn */
+    int len = 0;
+    char *p = buf;
+    for (; *p != 'e'; p++) {
+        if (*p != '.') {
+            digits[len++] = *p;
+        }
+    }
+    while (len > 1 && digits[len - 1] == '0') {
+        len--;
+    }
+    
+    *dec_exp = atoi(p + 1) - (len - 1);
+    return len;
+}
+
+/* Find the normalized number and the boundaries half way to its
+ * neighbours, all with the same exponent as the upper boundary
+ */
+void compute_boundaries(double number, diyfp *w, diyfp *minus, diyfp *plus)
+{
+    uint64_t bits;
+    memcpy(&bits, &number, sizeof(bits));
+    
+    uint64_t fraction = bits & ((1ULL << 52) - 1);
+    int biased_exp = (int)(bits >> 52);
+    
+    diyfp v;
+    if (biased_exp == 0) {
+        /* denormal */
+        v.f = fraction;
+        v.e = 1 - 1075;
+    } else {
+        v.f = fraction | (1ULL << 52);
+        v.e = biased_exp - 1075;
+    }
+    
+    /* at a power of two, the next number down is closer than the next
+     * one up
+     */
+    int lower_closer = fraction == 0 && biased_exp > 1;
+    
+    diyfp m_plus = { 2 * v.f + 1, v.e - 1 };
+    diyfp m_minus;
+    if (lower_closer) {
+        m_minus.f = 4 * v.f - 1;
+        m_minus.e = v.e - 2;
+    } else {
+        m_minus.f = 2 * v.f - 1;
+        m_minus.e = v.e - 1;
+    }
+    
+    *plus = diyfp_normalize(m_plus);
+    minus->f = m_minus.f << (m_minus.e - plus->e);
+    minus->e = plus->e;
+    *w = diyfp_normalize(v);
+}
+
+/* Find the cached power of ten which brings a number with binary
+ * exponent e into [ALPHA, GAMMA]
+ */
+cached_power find_cached_power(int e)
+{
+    /* k = ceil((ALPHA - e - 1) * log10(2)) */
+    int f = ALPHA - e - 1;
+    int k = (f * 78913) / (1 << 18) + (f > 0);
+    
+    int index = (-CACHED_POWERS_MIN_EXP + k + (CACHED_POWERS_STEP - 1)) / CACHED_POWERS_STEP;
+    
+    return cached_powers[index];
+}
+
+/* Multiply, keeping the rounded upper 64 bits of the product
+ */
+diyfp diyfp_mul(diyfp x, diyfp y)
+{
+    unsigned __int128 p = (unsigned __int128)x.f * y.f;
+    uint64_t h = (uint64_t)(p >> 64);
+    uint64_t l = (uint64_t)p;
+    
+    diyfp r = { h + (l >> 63), x.e + y.e + 64 };
+    return r;
+}
+
+/* Shift the significand up until its top bit is set
+ */
+diyfp diyfp_normalize(diyfp x)
+{
+    int shift = __builtin_clzll(x.f);
+    
+    x.f <<= shift;
+    x.e -= shift;
+    return x;
+}
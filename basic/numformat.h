@@ -0,0 +1,10 @@
+#ifndef numformat_h
+#define numformat_h
+
+/* Enough for a sign, 17 digits, a point, leading zeros and an exponent
+ */
+#define NUMFORMAT_SIZE 32
+
+extern int numformat_double(double number, char *buf);
+
+#endif /* numformat_h */
@@ -0,0 +1,9 @@
+#ifndef numparse_h
+#define numparse_h
+
+#include <stdint.h>
+
+extern int numparse_double(const char *text, double *number);
+extern int numparse_integer(const char *text, int64_t *integer);
+
+#endif /* numparse_h */
@@ -1,19 +1,39 @@
 #include <stdio.h>
 #include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
 
+#include "counters.h"
 #include "output.h"
 #include "safemem.h"
 
 static const int TAB_SIZE = 8;
 
+/* Output is gathered in a buffer and written to stdout in one go. A
+ * terminal gets each line as soon as it's finished; anything else gets
+ * the buffer when it fills, or when output_flush is called.
+ */
+static const int BUFFER_SIZE = 4096;
+static const int BLOCK_BUFFER_SIZE = 65536;
+
+static const char blanks[] = "                                ";
+
 struct output
 {
     int col;
     int buflen;
-    char *buffer;
+    char *buffer;       /* output_print formats into this */
+    
+    char *pending;      /* written but not yet flushed */
+    int used;
+    int size;
+    int line_flush;
 };
 
 static void output_tab(output *out);
+static void output_spaces(output *out, int n);
+static void output_write(output *out, const char *text, int len);
+static int is_plain(char ch);
 
 /* Allocate and oupput stream
  */
@@ -22,6 +42,9 @@ output *output_alloc()
     output *out = safe_calloc(1, sizeof(output));
     out->buflen = 80;
     out->buffer = safe_calloc(out->buflen, 1);
+    out->size = BUFFER_SIZE;
+    out->pending = safe_malloc(out->size);
+    out->line_flush = isatty(STDOUT_FILENO);
     return out;
 }
 
@@ -30,11 +53,39 @@ output *output_alloc()
 void output_free(output *out)
 {
     if (out) {
+        output_flush(out);
         free(out->buffer);
+        free(out->pending);
     }
     free(out);
 }
 
+/* When stdout isn't a terminal, write output in large blocks. Has
+ * no effect on a terminal, which always gets whole lines.
+ */
+void output_set_block_buffered(output *out, int block)
+{
+    if (out->line_flush) {
+        return;
+    }
+    
+    output_flush(out);
+    out->size = block ? BLOCK_BUFFER_SIZE : BUFFER_SIZE;
+    out->pending = safe_realloc(out->pending, out->size);
+}
+
+/* Write out anything buffered. Must be called before anything else
+ * writes to the terminal.
+ */
+void output_flush(output *out)
+{
+    if (out->used) {
+        fwrite(out->pending, 1, out->used, stdout);
+        out->used = 0;
+    }
+    fflush(stdout);
+}
+
 /* Directly set the column
  */
 void output_set_col(output *out, int col)
@@ -54,46 +105,64 @@ void output_print(output *out, const char *fmt, ...)
     if (n >= out->buflen) {
         out->buflen = n + 1;
         out->buffer = safe_realloc(out->buffer, out->buflen);
+        
+        va_start(args, fmt);
+        vsnprintf(out->buffer, out->buflen, fmt, args);
+        va_end(args);
     }
-
-    va_start(args, fmt);
-    vsnprintf(out->buffer, out->buflen, fmt, args);
-    va_end(args);
     
-    for (const char *p = out->buffer; *p; p++) {
+    const char *p = out->buffer;
+    const char *end = out->buffer + n;
+    int newline = 0;
+    
+    while (p < end) {
+        /* copy a run of characters which just advance the column */
+        const char *run = p;
+        while (p < end && is_plain(*p)) {
+            p++;
+        }
+        if (p > run) {
+            output_write(out, run, (int)(p - run));
+            out->col += p - run;
+        }
+        
+        if (p == end) {
+            break;
+        }
+        
         switch (*p) {
         case '\n':
-            putchar('\r');
-            putchar('\n');
+            output_write(out, "\r\n", 2);
             out->col = 0;
+            newline = 1;
             break;
-            
+        
         case '\r':
-            putchar('\r');
+            output_write(out, "\r", 1);
             out->col = 0;
             break;
-            
+        
         case '\b':
         case 127:
-            putchar(*p);
+            output_write(out, p, 1);
             if (out->col) {
                 out->col--;
             }
             break;
-            
+        
         case '\t':
             output_tab(out);
-            continue;
-            
-        default:
-            out->col++;
-            putchar(*p);
             break;
         }
+        p++;
+    }
+    
+    if (newline && out->line_flush) {
+        output_flush(out);
     }
 }
 
-/* output a tab character as spaces 
+/* output a tab character as spaces
  */
 void output_tab(output *out)
 {
@@ -101,19 +170,62 @@ void output_tab(output *out)
     int spaces = TAB_SIZE - n;
     
     out->col += spaces;
-    while (spaces--) {
-        putchar(' ');
-    }
+    output_spaces(out, spaces);
 }
 
 /* tab the output to the given column, if possible
  */
 void output_tab_to_col(output *out, int col)
 {
-    while (out->col < col) {
-        putchar(' ');
-        out->col++;
+    if (out->col < col) {
+        output_spaces(out, col - out->col);
+        out->col = col;
     }
 }
 
+/* Write n spaces
+ */
+void output_spaces(output *out, int n)
+{
+    int chunk = sizeof(blanks) - 1;
+    
+    for (; n > chunk; n -= chunk) {
+        output_write(out, blanks, chunk);
+    }
+    output_write(out, blanks, n);
+}
+
+/* Add text to the buffer, flushing first if it won't fit. Text bigger
+ * than the whole buffer is written directly.
+ */
+void output_write(output *out, const char *text, int len)
+{
+    basic_counters.output_bytes += len;
+    
+    if (out->used + len > out->size) {
+        output_flush(out);
+        if (len > out->size) {
+            fwrite(text, 1, len, stdout);
+            return;
+        }
+    }
+    
+    memcpy(out->pending + out->used, text, len);
+    out->used += len;
+}
 
+/* Returns 1 if ch is printed as itself and moves one column on
+ */
+int is_plain(char ch)
+{
+    switch (ch) {
+    case '\n':
+    case '\r':
+    case '\b':
+    case 127:
+    case '\t':
+        return 0;
+    }
+    
+    return 1;
+}
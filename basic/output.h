@@ -5,6 +5,8 @@ typedef struct output output;
 
 extern output *output_alloc();
 extern void output_free(output *out);
+extern void output_set_block_buffered(output *out, int block);
+extern void output_flush(output *out);
 extern void output_set_col(output *out, int col);
 extern void output_tab_to_col(output *out, int col);
 extern void output_print(output *out, const char *fmt, ...);
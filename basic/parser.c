@@ -4,11 +4,13 @@
 #include <string.h>
 
 #include "keyword.h"
+#include "numparse.h"
 #include "parser.h"
 #include "program.h"
 #include "safemem.h"
 #include "statement.h"
 #include "stringutil.h"
+#include "strobj.h"
 #include "value.h"
 
 static inline char parser_peek(parser *prs)
@@ -34,6 +36,7 @@ static inline char parser_get(parser *prs)
 
 static void parser_reset(parser *prs);
 static statement *parse_statement(parser *prs, int from_repl);
+static void store_statement(program *pgm, statement *stmt);
 static void parse_line_number(parser *prs, statement *stmt);
 static void parse_identifier(parser *prs);
 static void parse_number(parser *prs);
@@ -42,7 +45,6 @@ static void parse_operator(parser *prs);
 static int read_line(parser *prs, FILE *fp);
 static void append_line_buffer(parser *prs, char ch);
 static void grow_line_buffer(parser *prs);
-static const char *describe_token(token_type type);
 
 /* Allocate and initialize a parser
  */
@@ -51,9 +53,17 @@ parser *parser_alloc()
     parser *prs = (parser*)safe_calloc(1, sizeof(parser));
     prs->line_buffer_size = 80;
     prs->line_buffer = safe_calloc(prs->line_buffer_size, sizeof(char));
+    prs->strings = strobj_table_alloc();
     return prs;
 }
 
+/* Print every expression before and after constant folding
+ */
+void parser_set_dump_folding(parser *prs, int dump)
+{
+    prs->dump_folding = dump;
+}
+
 /* Free a parser
  */
 void parser_free(parser *prs)
@@ -64,6 +74,7 @@ void parser_free(parser *prs)
     
     free(prs->error_msg);
     free(prs->line_buffer);
+    strobj_table_free(prs->strings);
     free(prs);
 }
 
@@ -77,6 +88,11 @@ int parser_parse_file(parser *prs, FILE *fp, program *pgm)
 {
     int errs = 0;
     
+    /* the whole file goes in one arena, which lays the program out in
+     * memory in order
+     */
+    prs->nodes = arena_alloc();
+    
     while (1) {
         parser_reset(prs);
         
@@ -93,10 +109,13 @@ int parser_parse_file(parser *prs, FILE *fp, program *pgm)
         statement *stmt = parse_statement(prs, 0);
     
         if (stmt) {
-            program_insert_statement(pgm, stmt);
+            store_statement(pgm, stmt);
         }
     }
-
+    
+    arena_release(prs->nodes);
+    prs->nodes = NULL;
+    
     return errs ? -1 : 0;
 }
 
@@ -124,12 +143,17 @@ int parser_parse_repl_line(parser *prs, char *line, program *pgm, statement **ps
     strncpy(prs->line_buffer, line, prs->line_buffer_size);
     prs->in_line_buffer = (int)strlen(prs->line_buffer);
     
+    prs->nodes = arena_alloc();
+    
     int repl = !isdigit(prs->line_buffer[0]);
     statement *stmt = parse_statement(prs, repl);
     
+    arena_release(prs->nodes);
+    prs->nodes = NULL;
+    
     if (stmt) {
         if (stmt->line >= 0) {
-            program_insert_statement(pgm, stmt);
+            store_statement(pgm, stmt);
         } else {
             *pstmt = stmt;
         }
@@ -158,7 +182,7 @@ void parser_reset(parser *prs)
  */
 statement *parse_statement(parser *prs, int from_repl)
 {
-    statement *stmt = statement_alloc();
+    statement *stmt = statement_alloc(prs->nodes);
     
     parse_line_number(prs, stmt);
     parse_next_token(prs);
@@ -170,7 +194,12 @@ statement *parse_statement(parser *prs, int from_repl)
         free(text);
     }
     
-    // TODO a line number with nothing behind it means to delete the line
+    if (stmt->line >= 0 && prs->token_type == TOK_END) {
+        /* a line number with nothing behind it means to delete the line;
+         * the statement is returned with no body
+         */
+        return stmt;
+    }
     
     if (kw == NULL) {
         parser_set_error(prs, "KEYWORD EXPECTED");
@@ -196,10 +225,23 @@ statement *parse_statement(parser *prs, int from_repl)
         return NULL;
     }
     
-    stmt->text = safe_strdup(prs->line_buffer);
+    stmt->text = arena_strdup(prs->nodes, prs->line_buffer);
     return stmt;
 }
 
+/* Put a numbered statement into the program, or delete its line if it
+ * has no body
+ */
+void store_statement(program *pgm, statement *stmt)
+{
+    if (stmt->body) {
+        program_insert_statement(pgm, stmt);
+    } else {
+        program_delete_line(pgm, stmt->line);
+        statement_free(stmt);
+    }
+}
+
 /* Parse a line number, if there is one, and set it into the statement
  */
 void parse_line_number(parser *prs, statement *stmt)
@@ -234,6 +276,25 @@ char *parser_extract_token_text(parser *prs)
     return text;
 }
 
+/* Make a copy of the current token text which lives as long as the
+ * statement being parsed, and so must not be freed
+ */
+char *parser_keep_token_text(parser *prs)
+{
+    size_t len = prs->token_end - prs->token_start;
+    char *text = parser_alloc_node(prs, len + 1);
+    memcpy(text, prs->line_buffer + prs->token_start, len);
+    return text;
+}
+
+/* Allocate zeroed memory for part of the statement being parsed. It's
+ * freed along with the statement.
+ */
+void *parser_alloc_node(parser *prs, size_t size)
+{
+    return arena_calloc(prs->nodes, 1, size);
+}
+
 /* Report an error
  */
 void parser_set_error(parser *prs, const char *fmt, ...)
@@ -284,7 +345,7 @@ char *parser_describe_token(parser *prs)
 
 /* Return a static description of a particular token type
  */
-const char *describe_token(token_type type)
+const char *parser_describe_token_type(token_type type)
 {
     switch (type) {
     case TOK_ERROR:
@@ -386,7 +447,7 @@ int parser_expect_operator(parser *prs, token_type token)
     }
     
     char *found = parser_describe_token(prs);
-    parser_set_error(prs, "EXPECTED %s; FOUND %s", describe_token(token), found);
+    parser_set_error(prs, "EXPECTED %s; FOUND %s", parser_describe_token_type(token), found);
     free(found);
     return 0;
 }
@@ -397,10 +458,8 @@ int parser_expect_operator(parser *prs, token_type token)
 value *parser_expect_number(parser *prs)
 {
     if (prs->token_type == TOK_NUMBER) {
-        char *text = parser_extract_token_text(prs);
         double num;
-        sscanf(text, "%lf", &num);
-        free(text);
+        numparse_double(prs->line_buffer + prs->token_start, &num);
         
         parse_next_token(prs);
         
@@ -414,12 +473,12 @@ value *parser_expect_number(parser *prs)
 }
 
 /* Expect a variable name
- * Returns an allocated variable name or NULL
+ * Returns the variable name, kept with the statement, or NULL
  */
 char *parser_expect_var(parser *prs)
 {
     if (prs->token_type == TOK_IDENTIFIER) {
-        char *text = parser_extract_token_text(prs);
+        char *text = parser_keep_token_text(prs);
         parse_next_token(prs);
         return text;
     }
@@ -476,7 +535,8 @@ int parser_expect_end_of_line(parser *prs)
     return 1;
 }
 
-/* On success, return an allocated copy of a parsed filename
+/* On success, return a copy of a parsed filename, kept with the
+ * statement
  * On failure, returns NULL
  * Filenames are 8.3 with alphanumerics. The extension may be omitted
  */
@@ -503,7 +563,7 @@ char *parser_expect_filename(parser *prs)
     }
     
     prs->token_end = index;
-    char *filename = parser_extract_token_text(prs);
+    char *filename = parser_keep_token_text(prs);
     parse_next_token(prs);
     return filename;
 }
@@ -537,7 +597,7 @@ void parse_next_token(parser *prs)
     }
 }
 
-/* Parse an identifier (which might end with $ if it's a variable*
+/* Parse an identifier (which might end with $ or % if it's a variable)
  */
 void parse_identifier(parser *prs)
 {
@@ -547,7 +607,7 @@ void parse_identifier(parser *prs)
         parser_next(prs);
     }
         
-    if (parser_peek(prs) == '$') {
+    if (parser_peek(prs) == '$' || parser_peek(prs) == '%') {
         parser_next(prs);
     }
 }
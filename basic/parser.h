@@ -4,9 +4,11 @@
 #include <setjmp.h>
 #include <stdio.h>
 
+typedef struct arena arena;
 typedef struct program program;
 typedef struct parser parser;
 typedef struct statement statement;
+typedef struct strobj_table strobj_table;
 typedef enum source source;
 typedef enum token_type token_type;
 typedef struct value value;
@@ -70,6 +72,13 @@ struct parser
     enum token_type token_type;
     
     char *error_msg;
+    int dump_folding;
+    strobj_table *strings;
+    
+    /* what's parsed is allocated here; each file and each REPL line
+     * gets its own arena
+     */
+    arena *nodes;
 };
 
 static inline int parser_error(parser *prs)
@@ -79,12 +88,16 @@ static inline int parser_error(parser *prs)
 
 extern parser *parser_alloc();
 extern void parser_free(parser *p);
+extern void parser_set_dump_folding(parser *prs, int dump);
 extern int parser_parse_file(parser *prs, FILE *fp, program *pgm);
 extern int parser_parse_repl_line(parser *prs, char *line, program *pgm, statement **stmt);
 extern void parse_next_token(parser *prs);
 extern char *parser_extract_token_text(parser *prs);
+extern char *parser_keep_token_text(parser *prs);
+extern void *parser_alloc_node(parser *prs, size_t size);
 extern void parser_set_error(parser *prs, const char *fmt, ...);
 extern char *parser_describe_token(parser *prs);
+extern const char *parser_describe_token_type(token_type type);
 extern int parser_expect_id(parser *prs, const char *id);
 extern int parser_expect_operator(parser *prs, token_type token);
 extern value *parser_expect_number(parser *prs);
@@ -1,9 +1,10 @@
-#include <ctype.h>
 #include <stdio.h>
 #include <string.h>
 
 #include "assert.h"
+#include "compile.h"
 #include "expression.h"
+#include "numformat.h"
 #include "output.h"
 #include "parser.h"
 #include "print.h"
@@ -40,17 +41,16 @@ struct print_node
 };
 
 static void print_execute(statement_body *body, runtime *rt);
-static void print_number(output *out, const char *fmt, double number);
 static void print_free(statement_body *body);
-static print_part *part_alloc(expression *exp, print_spacing spacing);
-static void part_free(print_part *part);
+static void print_compile(statement_body *body, compiler *cmp);
+static print_part *part_alloc(parser *prs, expression *exp, print_spacing spacing);
 
 /* parse the body of a print statement
  */
 void print_parse(parser *prs, statement *stmt)
 {    
-    print_node *node = (print_node *)safe_calloc(1, sizeof(print_node));
-
+    print_node *node = (print_node *)parser_alloc_node(prs, sizeof(print_node));
+    
     while (1) {
         if (prs->token_type == TOK_END) {
             break;
@@ -72,7 +72,7 @@ void print_parse(parser *prs, statement *stmt)
             parser_set_error(prs, "EXPECTED , or ; BETWEEN PRINT ITEMS");            
         }
         
-        print_part *part = part_alloc(exp, spacing);
+        print_part *part = part_alloc(prs, exp, spacing);
         
         if (node->parts_tail == NULL) {
             node->parts = part;
@@ -88,27 +88,20 @@ void print_parse(parser *prs, statement *stmt)
             
     node->body.execute = &print_execute;
     node->body.free = &print_free;
+    node->body.compile = &print_compile;
     
     stmt->body = &node->body;
 }
 
-/* free a print node 
+/* free a print node's expressions
  */
 void print_free(statement_body *body)
 {
     print_node *node = (print_node *)body;
-    if (node == NULL) {
-        return;
-    }
     
-    print_part *curr = node->parts;
-    while (curr) {
-        print_part *next = curr->next;
-        part_free(curr);
-        curr = next;
+    for (print_part *part = node->parts; part; part = part->next) {
+        expression_free(part->exp);
     }
-    
-    free(node);
 }
 
 /* evaluate the print statement
@@ -120,30 +113,14 @@ void print_execute(statement_body *body, runtime *rt)
     
     
     for (print_part *p = node->parts; p; p = p->next) {
-        value *val = expression_evaluate(p->exp, rt);
+        value val;
         
-        // TODO really want (a) a more specific reason why expressions fail, and
-        // (b) a way to pass this up so the caller can print context like line #
-        if (val == NULL) {
+        if (!expression_evaluate(p->exp, rt, &val)) {
             return;
         }
         
-        switch (val->type) {
-        case TYPE_VOID:
-            break;
-            
-        case TYPE_BOOLEAN:
-            output_print(out, "%d", val->boolean);
-            break;
-        
-        case TYPE_NUMBER:
-            print_number(out, "%lf", val->number);
-            break;
-        
-        case TYPE_STRING:
-            output_print(out, "%s", val->string);
-            break;
-        }
+        print_value(out, &val);
+        value_clear(&val);
         
         if (p->spacing == SPC_TAB) {
             output_print(out, "\t");
@@ -153,79 +130,62 @@ void print_execute(statement_body *body, runtime *rt)
     output_print(out, "\n");
 }
 
-/* Format and print a number. Mostly we want to get rid of
- * trailing zeroes past the decimal (1.20000 should be 1.2)
- * which printf format strings don't reresent.
+/* compile a print statement
  */
-void print_number(output *out, const char *fmt, double number)
+void print_compile(statement_body *body, compiler *cmp)
 {
-    char str[32];
-    char *strp = str;
-    
-    int len = snprintf(str, sizeof(str), fmt, number);
-    if (len > sizeof(str)) {
-        strp = safe_malloc(len + 1);
-        snprintf(strp, len + 1, fmt, number);
-    }
-    
-    char *p = strp + len - 1;
-    
-    while (p >= strp && *p == '0') {
-        p--;
-    }
-    p++;
+    print_node *node = (print_node *)body;
     
-    if (p < strp + len) {
-        /* p now points at the first of a trailing string of
-         * zeroes. make sure we're actually looking at digits
-         * past a decimal point (we could have exponential 
-         * notation and something like 1.0E+10)
-         */
-        char *q = p;
+    for (print_part *p = node->parts; p; p = p->next) {
+        expression_compile(p->exp, cmp);
+        compiler_emit(cmp, OP_PRINT);
         
-        while (q >= strp) {
-            if (!isdigit(*q)) {
-                break;
-            }
-            q--;
+        if (p->spacing == SPC_TAB) {
+            compiler_emit(cmp, OP_PRINT_TAB);
         }
+    }
+    
+    compiler_emit(cmp, OP_PRINT_NL);
+}
+
+/* Print a single value in its PRINT representation
+ */
+void print_value(output *out, value *val)
+{
+    switch (val->type) {
+    case TYPE_VOID:
+        break;
         
-        if (q >= strp && *q == '.') {
-            if (p == q + 1) {
-                /* there are no non-zero digits to the right of the decimal
-                 * point, so remove that as well.
-                 */
-                p--;
-            }
-            
-            *p = '\0';
+    case TYPE_BOOLEAN:
+        output_print(out, "%d", val->boolean);
+        break;
+    
+    case TYPE_NUMBER:
+        {
+            char buf[NUMFORMAT_SIZE];
+            numformat_double(val->number, buf);
+            output_print(out, "%s", buf);
         }
-    }
+        break;
     
-    output_print(out, "%s", strp);
+    case TYPE_STRING:
+        output_print(out, "%s", val->string->text);
+        break;
     
-    if (strp != str) {
-        free(strp);
+    case TYPE_INTEGER:
+        output_print(out, "%lld", (long long)val->integer);
+        break;
     }
 }
 
 
 /* allocate a part
  */
-print_part *part_alloc(expression *exp, print_spacing spacing)
+print_part *part_alloc(parser *prs, expression *exp, print_spacing spacing)
 {
-    print_part *part = safe_calloc(1, sizeof(print_part));
+    print_part *part = parser_alloc_node(prs, sizeof(print_part));
     part->exp = exp;
     part->spacing = spacing;
     return part;
 }
 
-/* free a part
- */
-void part_free(print_part *part)
-{
-    if (part) {
-        expression_free(part->exp);
-    }
-    free(part);
-}
@@ -1,9 +1,12 @@
 #ifndef print_h
 #define print_h
 
+typedef struct output output;
 typedef struct parser parser;
 typedef struct statement statement;
+typedef struct value value;
 
 extern void print_parse(parser *prs, statement *stmt);
+extern void print_value(output *out, value *val);
 
 #endif /* print_h */
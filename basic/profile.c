@@ -0,0 +1,96 @@
+#include <ctype.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "profile.h"
+#include "program.h"
+#include "safemem.h"
+#include "statement.h"
+
+static int compare_self_time(const void *left, const void *right);
+
+/* Returns a monotonic time in nanoseconds
+ */
+uint64_t profile_clock()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+/* Clear the counts from any previous run
+ */
+void profile_reset(program *pgm)
+{
+    for (statement *stmt = pgm->head; stmt; stmt = stmt->next) {
+        stmt->hits = 0;
+        stmt->nsecs = 0;
+    }
+}
+
+/* Print the statements which ran, those which took the most time
+ * first
+ */
+void profile_report(program *pgm, FILE *fp)
+{
+    int count = 0;
+    uint64_t total = 0;
+    unsigned long hits = 0;
+    
+    for (statement *stmt = pgm->head; stmt; stmt = stmt->next) {
+        if (stmt->hits) {
+            count++;
+            total += stmt->nsecs;
+            hits += stmt->hits;
+        }
+    }
+    
+    statement **stmts = safe_calloc(count ? count : 1, sizeof(statement *));
+    int n = 0;
+    for (statement *stmt = pgm->head; stmt; stmt = stmt->next) {
+        if (stmt->hits) {
+            stmts[n++] = stmt;
+        }
+    }
+    
+    qsort(stmts, count, sizeof(statement *), &compare_self_time);
+    
+    fprintf(fp, "\n%6s %12s %12s %7s  %s\n", "LINE", "HITS", "SELF MS", "SELF %", "STATEMENT");
+    for (int i = 0; i < count; i++) {
+        statement *stmt = stmts[i];
+        
+        /* the text starts with the line number, which has its own column */
+        const char *text = stmt->text;
+        while (isdigit(*text)) {
+            text++;
+        }
+        while (isspace(*text)) {
+            text++;
+        }
+        
+        fprintf(fp, "%6d %12lu %12.3f %6.1f%%  %s\n",
+            stmt->line,
+            stmt->hits,
+            stmt->nsecs / 1e6,
+            total ? 100.0 * stmt->nsecs / total : 0.0,
+            text);
+    }
+    fprintf(fp, "%6s %12lu %12.3f\n", "TOTAL", hits, total / 1e6);
+    
+    free(stmts);
+}
+
+/* qsort comparison putting the statements with the most self time
+ * first
+ */
+int compare_self_time(const void *left, const void *right)
+{
+    const statement *l = *(const statement **)left;
+    const statement *r = *(const statement **)right;
+    
+    if (l->nsecs != r->nsecs) {
+        return l->nsecs < r->nsecs ? 1 : -1;
+    }
+    
+    return l->line - r->line;
+}
@@ -0,0 +1,18 @@
+#ifndef profile_h
+#define profile_h
+
+#include <stdint.h>
+#include <stdio.h>
+
+/* The profiler counts how many times each statement runs and how much
+ * wall time is spent in it. The counts are kept in the statements
+ * themselves; the engines only touch them when profiling is on.
+ */
+
+typedef struct program program;
+
+extern uint64_t profile_clock();
+extern void profile_reset(program *pgm);
+extern void profile_report(program *pgm, FILE *fp);
+
+#endif /* profile_h */
@@ -1,11 +1,37 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include "compile.h"
 #include "program.h"
 #include "safemem.h"
 #include "statement.h"
 
-static statement *program_find_statment(program *pgm, int line);
+typedef enum link_mode link_mode;
+
+enum link_mode
+{
+    LINK_ALL,           /* resolve every reference */
+    LINK_STATEMENT,     /* resolve the references of one new statement */
+    LINK_LINE,          /* point references to line at stmt */
+    LINK_REMOVED,       /* clear references to stmt, which is going away */
+    LINK_CHECK,         /* report references which didn't resolve */
+};
+
+struct linker
+{
+    link_mode mode;
+    program *pgm;
+    statement *stmt;        /* the new statement, or the one being checked */
+    int missing;
+};
+
+static void program_changed(program *pgm);
+static int find_index(program *pgm, int line);
+static statement *find_exact(program *pgm, int line);
+static void relink_line(program *pgm, statement *stmt);
+static void link_program(program *pgm, linker *lnk);
+static void link_statement(statement *stmt, linker *lnk);
 
 /* Allocate an empty program
  */
@@ -14,6 +40,13 @@ program *program_alloc()
     program *pgm = safe_calloc(1, sizeof(program));
     pgm->head = NULL;
     pgm->tail = NULL;
+    pgm->lines = NULL;
+    pgm->count = 0;
+    pgm->allocated = 0;
+    pgm->code = NULL;
+    pgm->version = 0;
+    pgm->linked = 0;
+    pgm->checked = 0;
     
     return pgm;
 }
@@ -24,6 +57,7 @@ void program_free(program *pgm)
 {
     if (pgm) {
         program_new(pgm);
+        free(pgm->lines);
     }
     free(pgm);
 }
@@ -42,9 +76,15 @@ void program_new(program *pgm)
     }
     pgm->head = NULL;
     pgm->tail = NULL;
+    pgm->count = 0;
+    pgm->linked = 0;
+    
+    program_changed(pgm);
 }
 
-/* Insert a statement
+/* Insert a statement, replacing any existing statement with the same
+ * line number. Adding lines in order, as loading a program does, takes
+ * constant time.
  */
 void program_insert_statement(program *pgm, statement *stmt)
 {
@@ -52,9 +92,13 @@ void program_insert_statement(program *pgm, statement *stmt)
         return;
     }
     
-    statement *existing = program_find_statment(pgm, stmt->line);
-    if (existing && existing->line == stmt->line) {
+    program_changed(pgm);
+    
+    int index = find_index(pgm, stmt->line);
+    
+    if (index < pgm->count && pgm->lines[index]->line == stmt->line) {
         /* we need to replace an existing statement */
+        statement *existing = pgm->lines[index];
         statement *prev = existing->prev;
         statement *next = existing->next;
         
@@ -72,51 +116,229 @@ void program_insert_statement(program *pgm, statement *stmt)
         
         stmt->prev = prev;
         stmt->next = next;
+        pgm->lines[index] = stmt;
         
         statement_free(existing);
+        relink_line(pgm, stmt);
         return;
     }
     
     /* we are just inserting */
-    if (existing) {
-        /* inserting after an existing statement */
-        stmt->prev = existing;
-        stmt->next = existing->next;
-        existing->next = stmt;
-        
-        if (stmt->next) {
-            stmt->next->prev = stmt;
-        } else {
-            pgm->tail = stmt;
-        }
-    } else if (pgm->head) {
-        /* inserting before the first statement */
-        stmt->prev = NULL;
-        stmt->next = pgm->head;
-        
+    if (pgm->count == pgm->allocated) {
+        pgm->allocated = pgm->allocated ? 2 * pgm->allocated : 64;
+        pgm->lines = safe_realloc(pgm->lines, pgm->allocated * sizeof(pgm->lines[0]));
+    }
+    
+    memmove(&pgm->lines[index + 1], &pgm->lines[index], (pgm->count - index) * sizeof(pgm->lines[0]));
+    pgm->lines[index] = stmt;
+    pgm->count++;
+    
+    stmt->prev = index > 0 ? pgm->lines[index - 1] : NULL;
+    stmt->next = index + 1 < pgm->count ? pgm->lines[index + 1] : NULL;
+    
+    if (stmt->prev) {
+        stmt->prev->next = stmt;
+    } else {
         pgm->head = stmt;
+    }
+    
+    if (stmt->next) {
         stmt->next->prev = stmt;
     } else {
-        /* inserting and there are no existing statements */
-        pgm->head = stmt;
         pgm->tail = stmt;
     }
+    
+    relink_line(pgm, stmt);
+}
+
+/* Delete the statement with the given line number. Returns 1 if there
+ * was one, else 0.
+ */
+int program_delete_line(program *pgm, int line)
+{
+    statement *stmt = find_exact(pgm, line);
+    if (stmt == NULL) {
+        return 0;
+    }
+    
+    program_changed(pgm);
+    
+    if (pgm->linked) {
+        linker lnk = { .mode = LINK_REMOVED, .pgm = pgm, .stmt = stmt };
+        link_program(pgm, &lnk);
+    }
+    
+    int index = find_index(pgm, line);
+    pgm->count--;
+    memmove(&pgm->lines[index], &pgm->lines[index + 1], (pgm->count - index) * sizeof(pgm->lines[0]));
+    
+    if (stmt->prev) {
+        stmt->prev->next = stmt->next;
+    } else {
+        pgm->head = stmt->next;
+    }
+    
+    if (stmt->next) {
+        stmt->next->prev = stmt->prev;
+    } else {
+        pgm->tail = stmt->prev;
+    }
+    
+    statement_free(stmt);
+    return 1;
+}
+
+/* Returns the statement with the given line number, or if there isn't
+ * one the first after it, or NULL if there are none after it
+ */
+statement *program_find_line(program *pgm, int line)
+{
+    int index = find_index(pgm, line);
+    
+    return index < pgm->count ? pgm->lines[index] : NULL;
+}
+
+/* Link every line reference in the program, unless that has already
+ * been done and kept up to date by program_insert_statement. Reports
+ * references to lines which don't exist. Returns the number of them.
+ */
+int program_link(program *pgm)
+{
+    if (pgm->linked && pgm->checked == pgm->version) {
+        /* nothing has changed since the last check found no problems */
+        return 0;
+    }
+    
+    if (!pgm->linked) {
+        linker lnk = { .mode = LINK_ALL, .pgm = pgm };
+        link_program(pgm, &lnk);
+        pgm->linked = 1;
+    }
+    
+    linker lnk = { .mode = LINK_CHECK, .pgm = pgm };
+    link_program(pgm, &lnk);
+    
+    if (lnk.missing == 0) {
+        pgm->checked = pgm->version;
+    }
+    
+    return lnk.missing;
 }
 
-/* Search for a statement by line number. Returns the statment at
- * or before the given line number, or NULL if no statment matches
- * that criteria.
+/* Called by statements for each line they refer to
  */
-statement *program_find_statment(program *pgm, int line)
+void linker_resolve(linker *lnk, line_ref *ref)
 {
-    statement *prev = NULL;
-    statement *stmt = NULL;
+    switch (lnk->mode) {
+    case LINK_ALL:
+    case LINK_STATEMENT:
+        ref->target = find_exact(lnk->pgm, ref->line);
+        break;
+    
+    case LINK_LINE:
+        if (ref->line == lnk->stmt->line) {
+            ref->target = lnk->stmt;
+        }
+        break;
     
-    for (stmt = pgm->head; stmt != NULL; prev = stmt, stmt = stmt->next) {
-        if (stmt->line >= line) {
-            break;
+    case LINK_REMOVED:
+        if (ref->target == lnk->stmt) {
+            ref->target = NULL;
         }
+        break;
+    
+    case LINK_CHECK:
+        if (ref->target == NULL) {
+            fprintf(stderr, "LINE NUMBER %d DOES NOT EXIST IN %d\n", ref->line, lnk->stmt->line);
+            lnk->missing++;
+        }
+        break;
     }
+}
+
+/* After stmt has been put in a linked program, link its own references
+ * and point any references to its line at it. Nothing else can have
+ * changed.
+ */
+void relink_line(program *pgm, statement *stmt)
+{
+    if (!pgm->linked) {
+        return;
+    }
+    
+    linker lnk = { .mode = LINK_STATEMENT, .pgm = pgm, .stmt = stmt };
+    link_statement(stmt, &lnk);
     
-    return (stmt && stmt->line == line) ? stmt : prev;
+    lnk.mode = LINK_LINE;
+    link_program(pgm, &lnk);
+}
+
+/* Pass every statement's references to the linker
+ */
+void link_program(program *pgm, linker *lnk)
+{
+    for (statement *p = pgm->head; p; p = p->next) {
+        if (lnk->mode == LINK_CHECK) {
+            lnk->stmt = p;
+        }
+        link_statement(p, lnk);
+    }
+}
+
+/* Pass one statement's references to the linker
+ */
+void link_statement(statement *stmt, linker *lnk)
+{
+    if (stmt->body->link) {
+        stmt->body->link(stmt->body, lnk);
+    }
+}
+
+/* Note that the lines have changed. Compiled code refers to the
+ * statements, so it's now stale.
+ */
+void program_changed(program *pgm)
+{
+    pgm->version++;
+    bytecode_free(pgm->code);
+    pgm->code = NULL;
+}
+
+/* Binary search for the index of the first statement whose line
+ * number is at least line, which is count if there is none. Lines
+ * usually arrive in order, so check the end first.
+ */
+int find_index(program *pgm, int line)
+{
+    if (pgm->count == 0 || pgm->lines[pgm->count - 1]->line < line) {
+        return pgm->count;
+    }
+    
+    int low = 0;
+    int high = pgm->count - 1;
+    
+    while (low < high) {
+        int m = (low + high) / 2;
+        
+        if (pgm->lines[m]->line < line) {
+            low = m + 1;
+        } else {
+            high = m;
+        }
+    }
+    
+    return low;
+}
+
+/* Returns the statement with the given line number, or NULL if there
+ * isn't one
+ */
+statement *find_exact(program *pgm, int line)
+{
+    int index = find_index(pgm, line);
+    
+    if (index < pgm->count && pgm->lines[index]->line == line) {
+        return pgm->lines[index];
+    }
+    return NULL;
 }
@@ -1,18 +1,37 @@
 #ifndef program_h
 #define program_h
 
+typedef struct bytecode bytecode;
+typedef struct line_ref line_ref;
+typedef struct linker linker;
 typedef struct program program;
 typedef struct statement statement;
 
+/* Statements are kept both in a list, which is how the program runs,
+ * and in an array in line number order, which is how lines are found.
+ * Every change to the lines bumps version, so that work done for one
+ * RUN can be kept for the next if nothing has changed.
+ */
 struct program
 {
   statement *head;
   statement *tail;
+  statement **lines;
+  int count;
+  int allocated;
+  bytecode *code;
+  unsigned version;
+  int linked;
+  unsigned checked;     /* version last linked with nothing missing */
 };
 
 extern program *program_alloc();
 extern void program_free(program *pgm);
 extern void program_new(program *pgm);
 extern void program_insert_statement(program *pgm, statement *stmt);
+extern int program_delete_line(program *pgm, int line);
+extern statement *program_find_line(program *pgm, int line);
+extern int program_link(program *pgm);
+extern void linker_resolve(linker *lnk, line_ref *ref);
 
 #endif /* program_h */
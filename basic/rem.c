@@ -13,15 +13,15 @@ struct rem_node
 };
 
 static void rem_execute(statement_body *body, runtime *rt);
-static void rem_free(statement_body *body);
+static void rem_compile(statement_body *body, compiler *cmp);
 
 /* Parse the rem statement
  */
 void rem_parse(parser *prs, statement *stmt)
 {
-    rem_node *rem = safe_calloc(1, sizeof(rem_node));
+    rem_node *rem = parser_alloc_node(prs, sizeof(rem_node));
     rem->body.execute = &rem_execute;
-    rem->body.free = &rem_free;
+    rem->body.compile = &rem_compile;
     stmt->body = &rem->body;
 }
 
@@ -31,11 +31,10 @@ void rem_execute(statement_body *body, runtime *rt)
 {
 }
 
-/* free a rem node
+/* compile a rem node, which generates no code
  */
-void rem_free(statement_body *body)
+void rem_compile(statement_body *body, compiler *cmp)
 {
-    free(body);
 }
 
 
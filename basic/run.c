@@ -10,18 +10,25 @@ typedef struct run_node run_node;
 struct run_node
 {
     statement_body body;
+    int profile;
 };
 
 static void run_execute(statement_body *body, runtime *rt);
-static void run_free(statement_body *body);
 
 /* Parse the run statement
  */
 void run_parse(parser *prs, statement *stmt)
 {
-    run_node *run = safe_calloc(1, sizeof(run_node));
+    run_node *run = parser_alloc_node(prs, sizeof(run_node));
+    
+    if (prs->token_type != TOK_END) {
+        if (!parser_expect_id(prs, "PROFILE") || !parser_expect_end_of_line(prs)) {
+            return;
+        }
+        run->profile = 1;
+    }
+    
     run->body.execute = &run_execute;
-    run->body.free = &run_free;
     stmt->body = &run->body;
 }
 
@@ -29,14 +36,13 @@ void run_parse(parser *prs, statement *stmt)
  */
 void run_execute(statement_body *body, runtime *rt)
 {
-    runtime_run(rt);
-}
-
-/* free a run node
- */
-void run_free(statement_body *body)
-{
-    free(body);
+    run_node *run = (run_node *)body;
+    
+    if (run->profile) {
+        runtime_run_profiled(rt);
+    } else {
+        runtime_run(rt);
+    }
 }
 
 
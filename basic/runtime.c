@@ -3,46 +3,44 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "compile.h"
+#include "counters.h"
 #include "output.h"
+#include "profile.h"
 #include "program.h"
 #include "runtime.h"
 #include "safemem.h"
 #include "scope.h"
 #include "statement.h"
 #include "value.h"
-
-const int VARCOUNT = 26 * 27;
+#include "vartable.h"
+#include "vm.h"
 
 struct runtime
 {
     program *pgm;
     output *out;
     statement *curr_statement;
-    value *vars[2 * VARCOUNT];
-    statement **statements;
+    vartable vars;
     statement *goto_statement;
-    int allocated_statements;
-    int used_statements;
     scope_stack *scopes;
     char *error;
+    int tree_walk;
+    int profile;
 };
 
-static int var_is_string(int varidx)
-{
-    return (varidx >= VARCOUNT) && (varidx < 2 * VARCOUNT);
-}
-
-static int var_ref(const char *var);
-static void build_statement_index(runtime *rt, program *pgm);
+static void run_tree(runtime *rt);
+static void run_tree_profiled(runtime *rt);
 
 /* Allocate a runtime environment
  */
 runtime *runtime_alloc(program *pgm)
 {
-    runtime *rt = calloc(1, sizeof(runtime));
+    runtime *rt = safe_calloc(1, sizeof(runtime));
     rt->pgm = pgm;
     rt->out = output_alloc();
     rt->scopes = scope_stack_alloc();
+    vartable_init(&rt->vars);
     return rt;
 }
 
@@ -53,6 +51,8 @@ void runtime_free(runtime *rt)
     if (rt) {
         output_free(rt->out);
         scope_stack_free(rt->scopes);
+        vartable_clear(&rt->vars);
+        free(rt->error);
     }
     free(rt);
 }
@@ -71,6 +71,33 @@ output *runtime_get_output(runtime *rt)
     return rt->out;
 }
 
+/* Run programs by walking the parse tree instead of compiling them
+ * for the VM
+ */
+void runtime_set_tree_walk(runtime *rt, int tree_walk)
+{
+    rt->tree_walk = tree_walk;
+}
+
+/* Profile every run of the program
+ */
+void runtime_set_profile(runtime *rt, int profile)
+{
+    rt->profile = profile;
+}
+
+/* Run the program with the profiler on, whether or not it's on for
+ * every run
+ */
+void runtime_run_profiled(runtime *rt)
+{
+    int profile = rt->profile;
+    
+    rt->profile = 1;
+    runtime_run(rt);
+    rt->profile = profile;
+}
+
 /* Run the program
  */
 void runtime_run(runtime *rt)
@@ -79,9 +106,45 @@ void runtime_run(runtime *rt)
     rt->error = NULL;
     rt->goto_statement = NULL;
     
-    build_statement_index(rt, rt->pgm);
+    if (program_link(rt->pgm) != 0) {
+        return;
+    }
+    
     scope_stack_clear(rt->scopes);
     
+    if (rt->profile) {
+        profile_reset(rt->pgm);
+    }
+    
+    if (!rt->tree_walk) {
+        if (rt->pgm->code == NULL) {
+            rt->pgm->code = compile_program(rt->pgm);
+        }
+        if (rt->profile) {
+            bytecode_set_profiling(rt->pgm->code, 1);
+            vm_run(rt, rt->pgm->code);
+            bytecode_set_profiling(rt->pgm->code, 0);
+        } else {
+            vm_run(rt, rt->pgm->code);
+        }
+        rt->curr_statement = NULL;
+    } else if (rt->profile) {
+        run_tree_profiled(rt);
+    } else {
+        run_tree(rt);
+    }
+    
+    output_flush(rt->out);
+    
+    if (rt->profile) {
+        profile_report(rt->pgm, stderr);
+    }
+}
+
+/* Run the program by walking the parse tree
+ */
+void run_tree(runtime *rt)
+{
     rt->curr_statement = rt->pgm->head;
     
     while (rt->curr_statement)
@@ -102,14 +165,53 @@ void runtime_run(runtime *rt)
     }
 }
 
+/* run_tree, timing each statement for the profiler
+ */
+void run_tree_profiled(runtime *rt)
+{
+    rt->curr_statement = rt->pgm->head;
+    
+    while (rt->curr_statement)
+    {
+        statement *stmt = rt->curr_statement;
+        
+        rt->goto_statement = NULL;
+        
+        uint64_t start = profile_clock();
+        int ok = runtime_execute_statement(rt, stmt);
+        stmt->nsecs += profile_clock() - start;
+        stmt->hits++;
+        
+        if (!ok) {
+            break;
+        }
+        
+        if (rt->goto_statement) {
+            rt->curr_statement = rt->goto_statement;
+        } else {
+            rt->curr_statement = stmt->next;
+        }
+    }
+}
+
 /* Execute one statement, possibly printing a runtime error
  * Returns 1 on success, else 0
  */
 int runtime_execute_statement(runtime *rt, statement *stmt)
 {
+    basic_counters.statements++;
     stmt->body->execute(stmt->body, rt);
     
+    return !runtime_check_error(rt, stmt);
+}
+
+/* If a runtime error has been set, print it with the line number of
+ * stmt and clear it. Returns 1 if there was an error, else 0.
+ */
+int runtime_check_error(runtime *rt, statement *stmt)
+{
     if (rt->error) {
+        output_flush(rt->out);
         fprintf(stderr, "\n%s", rt->error);
         if (stmt->line >= 0) {
             fprintf(stderr, " IN %d", stmt->line);
@@ -119,10 +221,10 @@ int runtime_execute_statement(runtime *rt, statement *stmt)
         free(rt->error);
         rt->error = NULL;
         
-        return 0;
+        return 1;
     }
     
-    return 1;
+    return 0;
 }
 
 
@@ -150,75 +252,36 @@ void runtime_set_error(runtime *rt, const char *fmt, ...)
     va_end(args);
 }
 
-/* Get a variable
- * Returns NULL if the variable is undefined or if the name is
- * invalid
+/* Copy a variable, by the slot returned by runtime_var_slot, into val
+ * Returns 0 if the variable is undefined
  */
-value *runtime_getvar(runtime *rt, const char *var)
+int runtime_getvar(runtime *rt, int slot, value *val)
 {
-    int varidx = var_ref(var);
-    if (varidx < 0) {
-        return NULL;
-    }
-    
-    return rt->vars[varidx];
+    return vartable_get(&rt->vars, slot, val);
 }
 
-/* Set a variable. Returns 0 on failure, 1 on success
+/* Set a variable by the slot returned by runtime_var_slot. The
+ * variable takes over any string held by val, but not val itself.
+ * The parser has already checked that val has the variable's type.
  */
-int runtime_setvar(runtime *rt, const char *var, value *value)
+void runtime_setvar(runtime *rt, int slot, value *val)
 {
-    int varidx = var_ref(var);
-    if (varidx < 0) {
-        return 0;
-    }
-    
-    if (var_is_string(varidx)) {
-        if (value->type != TYPE_STRING) {
-            return 0;
-        }
-    } else if (value->type != TYPE_NUMBER) {
-        return 0;
-    }
-    
-    if (rt->vars[varidx] != NULL) {
-        value_free(rt->vars[varidx]);
-    }
-    rt->vars[varidx] = value;
-    
-    return 1;
+    vartable_set(&rt->vars, slot, val);
 }
 
-/* Sets the next statement to execute when the current statment
- * finishes. Sets a runtime error if the target line number doesn't
- * exist.
+/* Returns the variable table, for code which reads and writes
+ * variables often enough to skip the calls above
  */
-void runtime_goto(runtime *rt, int line_no)
+vartable *runtime_vars(runtime *rt)
 {
-    int low = 0;
-    int high = rt->used_statements - 1;
-    
-    while (low <= high) {
-        int m = (low + high) / 2;
-        int line_at_m = rt->statements[m]->line;
-        
-        if (line_at_m < line_no) {
-            low = m + 1;
-        } else if (line_at_m > line_no) {
-            high = m - 1;
-        } else {
-            rt->goto_statement = rt->statements[m];
-            return;
-        }
-    }
-    
-    runtime_set_error(rt, "LINE NUMBER %d DOES NOT EXIST", line_no);
+    return &rt->vars;
 }
 
 /* Set the next statement directly
  */
 void runtime_set_next_statement(runtime *rt, statement *stmt)
 {
+    basic_counters.jumps++;
     rt->goto_statement = stmt;
 }
 
@@ -233,10 +296,31 @@ statement *runtime_next_statement(runtime *rt)
     return NULL;
 }
 
-/* Parse a variable reference
- * Returns a variable reference or -1 if invalid
+/* Set the statement which is executing, for code running outside of
+ * runtime_run's loop
+ */
+void runtime_set_current_statement(runtime *rt, statement *stmt)
+{
+    rt->curr_statement = stmt;
+    rt->goto_statement = NULL;
+}
+
+/* Returns and clears the target of any jump made by the current
+ * statement
+ */
+statement *runtime_take_goto(runtime *rt)
+{
+    statement *stmt = rt->goto_statement;
+    rt->goto_statement = NULL;
+    return stmt;
+}
+
+/* Map a variable name to the slot which holds it. This is done once
+ * when the program is parsed, so that running code never has to look
+ * at variable names.
+ * Returns the slot or -1 if the name is invalid
  */
-int var_ref(const char *var)
+int runtime_var_slot(const char *var)
 {
     size_t len = strlen(var);
     if (len == 0) {
@@ -244,14 +328,15 @@ int var_ref(const char *var)
         return -1;
     }
     
-    /* if it ends in $, it's in the string set
+    /* if it ends in $, it's in the string set; if it ends in %, it's
+     * in the integer set
      */
     int base = 0;
-    if (var[len - 1] == '$') {
+    if (var[len - 1] == '$' || var[len - 1] == '%') {
         if (len == 1) {
             return -1;
         }
-        base = VARCOUNT;
+        base = var[len - 1] == '$' ? VARCOUNT : 2 * VARCOUNT;
         len--;
     }
     
@@ -273,33 +358,14 @@ int var_ref(const char *var)
         return -1;
     }
 
-    return base + 26 + 26 * (toupper(var[0] - 'A')) + toupper(var[1] - 'Z');
+    return base + 26 + 26 * (toupper(var[0]) - 'A') + (toupper(var[1]) - 'A');
 }
 
-/* Builds an array version of the statment list. Since we know the 
- * list is in sorted statement order, we can than bsearch it on line
- * number.
+/* Returns the type of value the variable in slot holds
  */
-void build_statement_index(runtime *rt, program *pgm)
+valuetype runtime_var_type(int slot)
 {
-    int count = 0;
-    
-    for (statement *p = pgm->head; p; p = p->next) {
-        count++;
-    }
-    
-    if (count > rt->allocated_statements) {
-        free(rt->statements);
-        rt->statements = safe_calloc(count, sizeof(rt->statements[0]));
-        rt->allocated_statements = count;
-    }
-    
-    rt->used_statements = count;
-    
-    count = 0;
-    for (statement *p = pgm->head; p; p = p->next) {
-        rt->statements[count++] = p;
-    }
+    return vartable_type(slot);
 }
 
 /* Returns the scope stack
@@ -2,8 +2,33 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "counters.h"
 #include "safemem.h"
 
+/* Blocks start small, so that an arena holding one line costs little,
+ * and double up to a limit as the arena fills
+ */
+static const size_t FIRST_BLOCK_SIZE = 512;
+static const size_t MAX_BLOCK_SIZE = 65536;
+static const size_t ARENA_ALIGN = 8;
+
+typedef struct arena_block arena_block;
+
+struct arena_block
+{
+    arena_block *prev;
+    char data[];
+};
+
+struct arena
+{
+    arena_block *blocks;    /* most recent first */
+    char *next;
+    char *end;
+    size_t block_size;
+    int refs;
+};
+
 /* Common out of memory hook
  */
 static void out_of_memory()
@@ -17,6 +42,8 @@ static void out_of_memory()
 void *safe_calloc(size_t count, size_t size)
 {
     void *p = calloc(count, size);
+    basic_counters.heap_allocs++;
+    basic_counters.heap_bytes += count * size;
     if (p == NULL) {
         out_of_memory();
     }
@@ -28,6 +55,8 @@ void *safe_calloc(size_t count, size_t size)
 void *safe_malloc(size_t size)
 {
     void *p = malloc(size);
+    basic_counters.heap_allocs++;
+    basic_counters.heap_bytes += size;
     if (p == NULL) {
         out_of_memory();
     }
@@ -39,6 +68,8 @@ void *safe_malloc(size_t size)
 void *safe_realloc(void *buffer, size_t new_size)
 {
     void *p = realloc(buffer, new_size);
+    basic_counters.heap_allocs++;
+    basic_counters.heap_bytes += new_size;
     if (!p) {
         out_of_memory();
     }
@@ -53,5 +84,80 @@ char *safe_strdup(const char *str)
     if (s == NULL) {
         out_of_memory();
     }
+    basic_counters.heap_allocs++;
+    basic_counters.heap_bytes += strlen(s) + 1;
+    return s;
+}
+
+/* Allocate an empty arena, with one reference
+ */
+arena *arena_alloc()
+{
+    arena *a = safe_calloc(1, sizeof(arena));
+    a->block_size = FIRST_BLOCK_SIZE;
+    a->refs = 1;
+    return a;
+}
+
+/* Take another reference to an arena
+ */
+arena *arena_retain(arena *a)
+{
+    a->refs++;
+    return a;
+}
+
+/* Drop a reference to an arena, freeing it and everything allocated
+ * from it if it was the last one
+ */
+void arena_release(arena *a)
+{
+    if (a == NULL || --a->refs > 0) {
+        return;
+    }
+    
+    while (a->blocks) {
+        arena_block *prev = a->blocks->prev;
+        free(a->blocks);
+        a->blocks = prev;
+    }
+    free(a);
+}
+
+/* calloc() from an arena
+ */
+void *arena_calloc(arena *a, size_t count, size_t size)
+{
+    size = (count * size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+    
+    if (size > (size_t)(a->end - a->next)) {
+        size_t block_size = a->block_size;
+        if (block_size < size) {
+            block_size = size;
+        }
+        
+        arena_block *block = safe_calloc(1, sizeof(arena_block) + block_size);
+        block->prev = a->blocks;
+        a->blocks = block;
+        a->next = block->data;
+        a->end = block->data + block_size;
+        
+        if (a->block_size < MAX_BLOCK_SIZE) {
+            a->block_size *= 2;
+        }
+    }
+    
+    void *p = a->next;
+    a->next += size;
+    return p;
+}
+
+/* strdup() into an arena
+ */
+char *arena_strdup(arena *a, const char *str)
+{
+    size_t len = strlen(str);
+    char *s = arena_calloc(a, len + 1, 1);
+    memcpy(s, str, len);
     return s;
 }
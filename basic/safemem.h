@@ -3,9 +3,21 @@
 
 #include <stdlib.h>
 
+typedef struct arena arena;
+
 extern void *safe_calloc(size_t count, size_t size);
 extern void *safe_malloc(size_t size);
 extern void *safe_realloc(void *buffer, size_t new_size);
 extern char *safe_strdup(const char *str);
 
+/* An arena hands out memory by bumping a pointer through large blocks,
+ * and frees all of it at once when the last reference to it is
+ * released. Nothing allocated from an arena is freed on its own.
+ */
+extern arena *arena_alloc();
+extern arena *arena_retain(arena *a);
+extern void arena_release(arena *a);
+extern void *arena_calloc(arena *a, size_t count, size_t size);
+extern char *arena_strdup(arena *a, const char *str);
+
 #endif /* safemem_h */
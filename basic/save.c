@@ -18,22 +18,19 @@ struct save_node
 };
 
 static void save_execute(statement_body *body, runtime *rt);
-static void save_free(statement_body *body);
 
 /* Parse the save statement
  */
 void save_parse(parser *prs, statement *stmt)
 {
-    save_node *save = safe_calloc(1, sizeof(save_node));
+    save_node *save = parser_alloc_node(prs, sizeof(save_node));
     
     if ((save->filename = parser_expect_filename(prs)) == NULL ||
         !parser_expect_end_of_line(prs)) {
-        save_free(&save->body);
         return;
     }
     
     save->body.execute = &save_execute;
-    save->body.free = &save_free;
     stmt->body = &save->body;
 }
 
@@ -60,16 +57,4 @@ void save_execute(statement_body *body, runtime *rt)
     fclose(fp);
 }
 
-/* free a save node
- */
-void save_free(statement_body *body)
-{
-    save_node *save = (save_node *)body;
-    if (save) {
-        free(save->filename);
-    }
-    
-    free(body);
-}
-
 
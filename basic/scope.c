@@ -1,38 +1,65 @@
+#include "counters.h"
 #include "safemem.h"
 #include "scope.h"
 
+static const int INITIAL_FRAMES = 16;
+
 /* Allocate a scope stack
  */
 scope_stack *scope_stack_alloc()
 {
-    return safe_calloc(1, sizeof(scope_stack));
+    scope_stack *stk = safe_calloc(1, sizeof(scope_stack));
+    stk->max_depth = SCOPE_DEFAULT_MAX_DEPTH;
+    return stk;
 }
 
 /* Free a scope stack
  */
 void scope_stack_free(scope_stack *stk)
 {
-    scope_stack_clear(stk);
+    if (stk) {
+        free(stk->frames);
+    }
     free(stk);
 }
 
-/* Push a scope onto the stack. scp must be dynamically allocated
- * and the stack becomes the owner of the memory.
+/* Set how many scopes may be active at once. Scopes which are already
+ * on the stack are left alone.
  */
-void scope_stack_push(scope_stack *stk, scope *scp)
+void scope_stack_set_max_depth(scope_stack *stk, int max_depth)
 {
-    scp->prev = stk->top;
-    stk->top = scp;
+    stk->max_depth = max_depth;
 }
 
-/* Pop and free the top of the stack, if it's not empty
+/* Push a scope of the given type onto the stack and return it for the
+ * caller to fill in. It stays valid until the next push or pop.
+ * Returns NULL if the stack is already at its maximum depth.
+ */
+scope *scope_stack_push(scope_stack *stk, scope_type type)
+{
+    if (stk->depth >= stk->max_depth) {
+        return NULL;
+    }
+    
+    if (stk->depth == stk->allocated) {
+        stk->allocated = stk->allocated ? 2 * stk->allocated : INITIAL_FRAMES;
+        stk->frames = safe_realloc(stk->frames, stk->allocated * sizeof(scope));
+    }
+    
+    scope *scp = &stk->frames[stk->depth++];
+    scp->type = type;
+    basic_counters.scope_pushes++;
+    
+    return scp;
+}
+
+/* Pop the top of the stack, if it's not empty
  */
 void scope_stack_pop(scope_stack *stk)
 {
-    if (stk->top) {
-        scope *prev = stk->top->prev;
-        stk->top->free(stk->top);
-        stk->top = prev;
+    if (stk->depth) {
+        stk->depth--;
+        basic_counters.scope_pops++;
     }
 }
 
@@ -42,10 +69,9 @@ void scope_stack_pop(scope_stack *stk)
  */
 void scope_stack_pop_until(scope_stack *stk, scope_type type)
 {
-    while (stk->top && stk->top->type != type) {
-        scope *prev = stk->top->prev;
-        stk->top->free(stk->top);
-        stk->top = prev;
+    while (stk->depth && stk->frames[stk->depth - 1].type != type) {
+        stk->depth--;
+        basic_counters.scope_pops++;
     }
 }
 
@@ -54,9 +80,5 @@ void scope_stack_pop_until(scope_stack *stk, scope_type type)
  */
 void scope_stack_clear(scope_stack *stk)
 {
-    while (stk->top) {
-        scope *prev = stk->top->prev;
-        stk->top->free(stk->top);
-        stk->top = prev;
-    }
+    stk->depth = 0;
 }
@@ -1,14 +1,25 @@
 #ifndef scope_h
 #define scope_h
 
+#include "vartable.h"
+
 /* while BASIC doesn't have scopes in the full sense of a modern language,
  * where it implies a namespace and object lifetime, it does have a function
  * stack (via GOSUB) and loops (FOR/NEXT).
+ *
+ * Frames are kept by value in one array which grows as needed, so
+ * pushing and popping never allocate. A frame must not own anything
+ * which would need freeing when it's popped.
  */
 
+typedef struct for_scope for_scope;
+typedef struct gosub_scope gosub_scope;
 typedef struct scope scope;
 typedef struct scope_stack scope_stack;
 typedef enum scope_type scope_type;
+typedef struct statement statement;
+
+#define SCOPE_DEFAULT_MAX_DEPTH 10000
 
 enum scope_type
 {
@@ -16,24 +27,57 @@ enum scope_type
     SCOPE_FOR,
 };
 
+struct for_scope
+{
+    statement *loop_top;
+    int loop_pc;            /* loop_top's code offset, for the VM */
+    
+    /* note that since the id never changes, ownership remains with
+     * the for_node.
+     */
+    const char *id;
+    int slot;
+    
+    /* unboxed, with the index's type */
+    varcell limit;
+    varcell step;
+};
+
+struct gosub_scope
+{
+    statement *return_stmt;
+};
+
 struct scope
 {
     scope_type type;
-    scope *prev;
-    
-    void (*free)(scope *scp);
+    union {
+        for_scope loop;
+        gosub_scope gosub;
+    } u;
 };
 
 struct scope_stack
 {
-    scope *top;
+    scope *frames;
+    int depth;
+    int allocated;
+    int max_depth;
 };
 
 extern scope_stack *scope_stack_alloc();
 extern void scope_stack_free(scope_stack *stk);
-extern void scope_stack_push(scope_stack *stk, scope *scp);
+extern void scope_stack_set_max_depth(scope_stack *stk, int max_depth);
+extern scope *scope_stack_push(scope_stack *stk, scope_type type);
 extern void scope_stack_pop(scope_stack *stk);
 extern void scope_stack_pop_until(scope_stack *stk, scope_type type);
 extern void scope_stack_clear(scope_stack *stk);
 
+/* Returns the innermost scope, or NULL if the stack is empty
+ */
+static inline scope *scope_stack_top(scope_stack *stk)
+{
+    return stk->depth ? &stk->frames[stk->depth - 1] : NULL;
+}
+
 #endif /* scope_h */
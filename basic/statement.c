@@ -1,19 +1,21 @@
 #include "safemem.h"
 #include "statement.h"
 
-/* Allocate an empty statement
+/* Allocate an empty statement in nodes, which it holds a reference to
  */
-statement *statement_alloc()
+statement *statement_alloc(arena *nodes)
 {
-    statement *stmt = (statement *)safe_calloc(1, sizeof(statement));
+    statement *stmt = (statement *)arena_calloc(nodes, 1, sizeof(statement));
     // stmt->next = NULL;
     // stmt->prev = NULL;
     stmt->line = -1;
+    stmt->nodes = arena_retain(nodes);
     
     return stmt;
 }
 
-/* Free a statment, include the body
+/* Free a statment, include the body. The memory goes back when the
+ * last statement in the arena is freed.
  */
 void statement_free(statement *stmt)
 {
@@ -21,11 +23,9 @@ void statement_free(statement *stmt)
         return;
     }
     
-    free(stmt->text);
-
-    if (stmt->body) {
+    if (stmt->body && stmt->body->free) {
         stmt->body->free(stmt->body);
     }
     
-    free(stmt);
+    arena_release(stmt->nodes);
 }
@@ -1,14 +1,45 @@
 #ifndef statement_h
 #define statement_h
 
+#include <stdint.h>
+
+typedef struct arena arena;
+typedef struct compiler compiler;
+typedef struct line_ref line_ref;
+typedef struct linker linker;
 typedef struct runtime runtime;
 typedef struct statement statement;
 typedef struct statement_body statement_body;
 
+/* A reference to another line of the program, such as the target of a
+ * GOTO. Before the program runs, target is linked to the statement with
+ * that line number.
+ */
+struct line_ref
+{
+    int line;
+    statement *target;
+};
+
+/* A statement and everything parsed for it live in an arena shared by
+ * the statements parsed along with it, so the body is never freed
+ * itself. free is optional, and releases anything the body holds
+ * outside of the arena.
+ */
 struct statement_body
 {
     void (*execute)(statement_body *body, runtime *rt);
     void (*free)(statement_body *body);
+    
+    /* optional; statements which don't lower themselves to bytecode are
+     * run by the VM through execute
+     */
+    void (*compile)(statement_body *body, compiler *cmp);
+    
+    /* optional; statements which refer to other lines pass each
+     * reference to linker_resolve
+     */
+    void (*link)(statement_body *body, linker *lnk);
 };
 
 struct statement
@@ -17,10 +48,16 @@ struct statement
     statement *next;
     char *text;
     int line;
+    int pc;
     statement_body *body;
+    arena *nodes;
+    
+    /* only counted when the program is run with the profiler on */
+    unsigned long hits;
+    uint64_t nsecs;
 };
 
-extern statement *statement_alloc();
+extern statement *statement_alloc(arena *nodes);
 extern void statement_free(statement *stmt);
 
 #endif /* statement_h */
@@ -0,0 +1,36 @@
+#include "counters.h"
+#include "expression.h"
+#include "parser.h"
+#include "runtime.h"
+#include "safemem.h"
+#include "statement.h"
+#include "stats.h"
+
+typedef struct stats_node stats_node;
+
+struct stats_node
+{
+    statement_body body;
+};
+
+static void stats_execute(statement_body *body, runtime *rt);
+
+/* Parse the stats statement
+ */
+void stats_parse(parser *prs, statement *stmt)
+{
+    if (!parser_expect_end_of_line(prs)) {
+        return;
+    }
+    
+    stats_node *stats = parser_alloc_node(prs, sizeof(stats_node));
+    stats->body.execute = &stats_execute;
+    stmt->body = &stats->body;
+}
+
+/* execute a stats node
+ */
+void stats_execute(statement_body *body, runtime *rt)
+{
+    counters_print(runtime_get_output(rt));
+}
@@ -0,0 +1,9 @@
+#ifndef stats_h
+#define stats_h
+
+typedef struct parser parser;
+typedef struct statement statement;
+
+extern void stats_parse(parser *prs, statement *stmt);
+
+#endif /* stats_h */
@@ -0,0 +1,238 @@
+#include <string.h>
+
+#include "safemem.h"
+#include "strobj.h"
+
+struct strobj_table
+{
+    strobj **slots;
+    size_t used;
+    size_t allocated;
+};
+
+static strobj *strobj_new(size_t len, size_t capacity);
+static size_t hash_text(const char *text, size_t len);
+static void grow_table(strobj_table *tbl);
+static void remove_from_table(strobj_table *tbl, strobj *str);
+
+/* Allocate a string holding a copy of len bytes of text, with one
+ * reference
+ */
+strobj *strobj_alloc(const char *text, size_t len)
+{
+    strobj *str = strobj_new(len, len);
+    memcpy(str->text, text, len);
+    return str;
+}
+
+/* Allocate a string holding a copy of a zero terminated string
+ */
+strobj *strobj_from_cstr(const char *text)
+{
+    return strobj_alloc(text, strlen(text));
+}
+
+/* Returns a new string holding left followed by right. Neither is
+ * released.
+ */
+strobj *strobj_concat(strobj *left, strobj *right)
+{
+    strobj *str = strobj_new(left->len + right->len, left->len + right->len);
+    memcpy(str->text, left->text, left->len);
+    memcpy(str->text + left->len, right->text, right->len);
+    return str;
+}
+
+/* Append tail to str, which consumes the caller's reference to str and
+ * returns a reference to the result. If that was the only reference,
+ * str is extended in place, growing its buffer geometrically so that
+ * building a string by repeated appends takes linear time. Interned
+ * strings are always copied, since the table would still find them
+ * by their old text.
+ */
+strobj *strobj_append(strobj *str, strobj *tail)
+{
+    size_t len = str->len + tail->len;
+    
+    if (str->refs != 1 || str->table) {
+        strobj *copy = strobj_new(len, 2 * len);
+        memcpy(copy->text, str->text, str->len);
+        memcpy(copy->text + str->len, tail->text, tail->len);
+        strobj_release(str);
+        return copy;
+    }
+    
+    if (len > str->capacity) {
+        str->capacity = len > 2 * str->capacity ? len : 2 * str->capacity;
+        str = safe_realloc(str, sizeof(strobj) + str->capacity + 1);
+    }
+    
+    memcpy(str->text + str->len, tail->text, tail->len);
+    str->len = len;
+    str->text[len] = '\0';
+    
+    return str;
+}
+
+/* Compare two strings, returning <0, 0 or >0 as for strcmp. A string
+ * which is a prefix of another orders first.
+ */
+int strobj_compare(strobj *left, strobj *right)
+{
+    if (left == right) {
+        return 0;
+    }
+    
+    size_t len = left->len < right->len ? left->len : right->len;
+    int cmp = memcmp(left->text, right->text, len);
+    if (cmp != 0) {
+        return cmp;
+    }
+    
+    return (left->len > right->len) - (left->len < right->len);
+}
+
+/* Drop a reference to a string, freeing it with the last one
+ */
+void strobj_release(strobj *str)
+{
+    if (str && --str->refs == 0) {
+        if (str->table) {
+            remove_from_table(str->table, str);
+        }
+        free(str);
+    }
+}
+
+/* Allocate a table for interning strings
+ */
+strobj_table *strobj_table_alloc()
+{
+    return safe_calloc(1, sizeof(strobj_table));
+}
+
+/* Free an interning table. The strings in it belong to whoever holds
+ * references to them, so they're only disowned.
+ */
+void strobj_table_free(strobj_table *tbl)
+{
+    if (tbl) {
+        for (size_t i = 0; i < tbl->allocated; i++) {
+            if (tbl->slots[i]) {
+                tbl->slots[i]->table = NULL;
+            }
+        }
+        free(tbl->slots);
+    }
+    free(tbl);
+}
+
+/* Returns a reference to the string in the table with the given text,
+ * adding it if it isn't there yet, so that equal literals share one
+ * string while any of them is alive
+ */
+strobj *strobj_intern(strobj_table *tbl, const char *text, size_t len)
+{
+    if (4 * (tbl->used + 1) > 3 * tbl->allocated) {
+        grow_table(tbl);
+    }
+    
+    size_t mask = tbl->allocated - 1;
+    size_t i = hash_text(text, len) & mask;
+    
+    for (; tbl->slots[i]; i = (i + 1) & mask) {
+        strobj *str = tbl->slots[i];
+        if (str->len == len && memcmp(str->text, text, len) == 0) {
+            return strobj_retain(str);
+        }
+    }
+    
+    strobj *str = strobj_alloc(text, len);
+    str->table = tbl;
+    tbl->slots[i] = str;
+    tbl->used++;
+    
+    return str;
+}
+
+/* Allocate an uninitialized (but terminated) string of length len,
+ * with room for capacity bytes of text
+ */
+strobj *strobj_new(size_t len, size_t capacity)
+{
+    strobj *str = safe_malloc(sizeof(strobj) + capacity + 1);
+    str->refs = 1;
+    str->len = len;
+    str->capacity = capacity;
+    str->table = NULL;
+    str->text[len] = '\0';
+    return str;
+}
+
+/* FNV-1a hash of some text
+ */
+size_t hash_text(const char *text, size_t len)
+{
+    size_t hash = 2166136261u;
+    
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ (unsigned char)text[i]) * 16777619u;
+    }
+    
+    return hash;
+}
+
+/* Double the size of an interning table (its size is always a power
+ * of two)
+ */
+void grow_table(strobj_table *tbl)
+{
+    size_t old_allocated = tbl->allocated;
+    strobj **old_slots = tbl->slots;
+    
+    tbl->allocated = old_allocated ? 2 * old_allocated : 64;
+    tbl->slots = safe_calloc(tbl->allocated, sizeof(strobj *));
+    
+    size_t mask = tbl->allocated - 1;
+    for (size_t i = 0; i < old_allocated; i++) {
+        strobj *str = old_slots[i];
+        if (str) {
+            size_t j = hash_text(str->text, str->len) & mask;
+            while (tbl->slots[j]) {
+                j = (j + 1) & mask;
+            }
+            tbl->slots[j] = str;
+        }
+    }
+    
+    free(old_slots);
+}
+
+/* Take a string out of its table. Since the table is probed linearly,
+ * the strings after it in the same run are moved back into the hole
+ * where that brings them closer to their home slots, so that lookups
+ * never stop short at an empty slot.
+ */
+void remove_from_table(strobj_table *tbl, strobj *str)
+{
+    size_t mask = tbl->allocated - 1;
+    size_t hole = hash_text(str->text, str->len) & mask;
+    
+    while (tbl->slots[hole] != str) {
+        hole = (hole + 1) & mask;
+    }
+    tbl->slots[hole] = NULL;
+    tbl->used--;
+    
+    for (size_t i = (hole + 1) & mask; tbl->slots[i]; i = (i + 1) & mask) {
+        strobj *next = tbl->slots[i];
+        size_t home = hash_text(next->text, next->len) & mask;
+        
+        /* next can move if its home isn't cyclically in (hole, i] */
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            tbl->slots[hole] = next;
+            tbl->slots[i] = NULL;
+            hole = i;
+        }
+    }
+}
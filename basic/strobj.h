@@ -0,0 +1,50 @@
+#ifndef strobj_h
+#define strobj_h
+
+#include <stddef.h>
+
+/* Strings are immutable, reference counted and know their length, so
+ * that copying a string value only bumps a count, and comparing two
+ * strings doesn't have to look for their ends. text is always
+ * terminated with a zero byte as well.
+ *
+ * The one exception to immutability is strobj_append, which extends a
+ * string in place when the caller holds the only reference to it.
+ *
+ * An interning table doesn't hold references to its strings. A string
+ * leaves its table when its last reference is released, so literals
+ * from replaced program lines don't live on in the parser's table.
+ */
+
+typedef struct strobj strobj;
+typedef struct strobj_table strobj_table;
+
+struct strobj
+{
+    int refs;
+    size_t len;
+    size_t capacity;
+    strobj_table *table;    /* the table it's interned in, if any */
+    char text[];
+};
+
+extern strobj *strobj_alloc(const char *text, size_t len);
+extern strobj *strobj_from_cstr(const char *text);
+extern strobj *strobj_concat(strobj *left, strobj *right);
+extern strobj *strobj_append(strobj *str, strobj *tail);
+extern int strobj_compare(strobj *left, strobj *right);
+extern void strobj_release(strobj *str);
+
+extern strobj_table *strobj_table_alloc();
+extern void strobj_table_free(strobj_table *tbl);
+extern strobj *strobj_intern(strobj_table *tbl, const char *text, size_t len);
+
+/* Take another reference to a string
+ */
+static inline strobj *strobj_retain(strobj *str)
+{
+    str->refs++;
+    return str;
+}
+
+#endif /* strobj_h */
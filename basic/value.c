@@ -1,3 +1,4 @@
+#include "counters.h"
 #include "safemem.h"
 #include "value.h"
 
@@ -6,6 +7,7 @@
 value *value_alloc_void()
 {
     value *val = safe_calloc(1, sizeof(value));
+    basic_counters.value_allocs++;
     val->type = TYPE_VOID;
     
     return val;
@@ -16,36 +18,46 @@ value *value_alloc_void()
 value *value_alloc_number(double v)
 {
     value *val = safe_calloc(1, sizeof(value));
+    basic_counters.value_allocs++;
     val->type = TYPE_NUMBER;
     val->number = v;
     
     return val;
 }
 
+/* Create an integer value
+ */
+value *value_alloc_integer(int64_t v)
+{
+    value *val = safe_calloc(1, sizeof(value));
+    basic_counters.value_allocs++;
+    val->type = TYPE_INTEGER;
+    val->integer = v;
+    
+    return val;
+}
+
 /* Create a boolean value (guaranteed to be zero or one)
  */
 value *value_alloc_boolean(int v)
 {
     value *val = safe_calloc(1, sizeof(value));
+    basic_counters.value_allocs++;
     val->type = TYPE_BOOLEAN;
     val->boolean = v != 0;
     
     return val;
 }
 
-/* Create a string value (which owns its own memory)
- * if allocated is set then the caller has already allocated the string
- * and the value should take ownership
+/* Create a string value, which takes over the caller's reference
+ * to s
  */
-value *value_alloc_string(char *s, valuealloc allocated)
+value *value_alloc_string(strobj *s)
 {
     value *val = safe_calloc(1, sizeof(value));
+    basic_counters.value_allocs++;
     val->type = TYPE_STRING;
-    if (allocated == VAL_ALLOCATED) {
-        val->string = s;
-    } else {
-        val->string = safe_strdup(s);
-    }
+    val->string = s;
     
     return val;
 }
@@ -54,8 +66,8 @@ value *value_alloc_string(char *s, valuealloc allocated)
  */
 void value_free(value *v)
 {
-    if (v && v->type == TYPE_STRING) {
-        free(v->string);
+    if (v) {
+        value_clear(v);
     }
     free(v);
 }
@@ -69,21 +81,8 @@ const char *value_describe_type(valuetype type)
         case TYPE_NUMBER: return "NUMBER";
         case TYPE_STRING: return "STRING";
         case TYPE_BOOLEAN: return "BOOLEAN";
+        case TYPE_INTEGER: return "INTEGER";
     }
     
     return "UNKNOWN";
 }
-
-/* Clone a value
- */
-value *value_clone(value *v)
-{
-    value *new_val = safe_calloc(1, sizeof(value));
-    *new_val = *v;
-  
-    if (new_val->type == TYPE_STRING) {
-        new_val->string = safe_strdup(new_val->string);
-    }
-  
-    return new_val;
-}
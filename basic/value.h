@@ -1,7 +1,11 @@
 #ifndef value_h
 #define value_h
 
-typedef enum valuealloc valuealloc;
+#include <stdint.h>
+
+#include "counters.h"
+#include "strobj.h"
+
 typedef enum valuetype valuetype;
 typedef struct value value;
 
@@ -10,28 +14,85 @@ enum valuetype
     TYPE_VOID,
     TYPE_NUMBER,
     TYPE_BOOLEAN,
-    TYPE_STRING
+    TYPE_STRING,
+    TYPE_INTEGER
 };
 
 struct value
 {
     valuetype type;
     double number;
+    int64_t integer;
     int boolean;
-    char *string;
+    strobj *string;
 };
 
-enum valuealloc {
-    VAL_ALLOCATED,
-    VAL_COPY,
-};
+/* Values are normally passed around by value (or in caller provided
+ * storage) so that numbers and booleans never touch the heap. The only
+ * heap storage a value owns is a reference to a string, so copying
+ * one never copies the text.
+ */
+static inline void value_set_number(value *v, double n)
+{
+    v->type = TYPE_NUMBER;
+    v->number = n;
+}
+
+static inline void value_set_integer(value *v, int64_t n)
+{
+    v->type = TYPE_INTEGER;
+    v->integer = n;
+}
+
+static inline void value_set_boolean(value *v, int b)
+{
+    v->type = TYPE_BOOLEAN;
+    v->boolean = b != 0;
+}
+
+static inline void value_set_void(value *v)
+{
+    v->type = TYPE_VOID;
+}
+
+/* Make v a string value, taking over the caller's reference to s
+ */
+static inline void value_set_string(value *v, strobj *s)
+{
+    v->type = TYPE_STRING;
+    v->string = s;
+}
+
+/* Copy a value into dst, which must not hold anything that needs
+ * to be released
+ */
+static inline void value_copy(value *dst, const value *src)
+{
+    *dst = *src;
+    basic_counters.value_copies++;
+    
+    if (dst->type == TYPE_STRING) {
+        strobj_retain(dst->string);
+    }
+}
+
+/* Release whatever a value owns and leave it void. This does not
+ * free the value itself.
+ */
+static inline void value_clear(value *v)
+{
+    if (v->type == TYPE_STRING) {
+        strobj_release(v->string);
+    }
+    v->type = TYPE_VOID;
+}
 
 extern value *value_alloc_void();
 extern value *value_alloc_number(double v);
+extern value *value_alloc_integer(int64_t v);
 extern value *value_alloc_boolean(int v);
-extern value *value_alloc_string(char *s, valuealloc allocated);
+extern value *value_alloc_string(strobj *s);
 extern const char *value_describe_type(valuetype type);
 extern void value_free(value *v);
-extern value *value_clone(value *v);
 
 #endif /* value_h */
@@ -0,0 +1,27 @@
+#include <string.h>
+
+#include "vartable.h"
+
+/* Start a table with every variable undefined
+ */
+void vartable_init(vartable *vars)
+{
+    for (int i = 0; i < VARCOUNT; i++) {
+        vars->cells[i].bits = VARCELL_UNDEFINED;
+    }
+    memset(&vars->cells[VARCOUNT], 0, 2 * VARCOUNT * sizeof(varcell));
+    memset(vars->integer_defined, 0, sizeof(vars->integer_defined));
+}
+
+/* Release the strings a table holds and leave every variable
+ * undefined
+ */
+void vartable_clear(vartable *vars)
+{
+    for (int i = VARCOUNT; i < 2 * VARCOUNT; i++) {
+        if (vars->cells[i].string) {
+            strobj_release(vars->cells[i].string);
+        }
+    }
+    vartable_init(vars);
+}
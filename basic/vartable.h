@@ -0,0 +1,116 @@
+#ifndef vartable_h
+#define vartable_h
+
+#include <stdint.h>
+
+#include "strobj.h"
+#include "value.h"
+
+/* Variables live inline in one array of 8 byte cells rather than in
+ * separately allocated values. Since the slot a name maps to already
+ * says what type the variable has, a cell only needs the payload: an
+ * unboxed double, an integer, or a string pointer.
+ *
+ * An undefined number holds a signalling NaN which arithmetic and
+ * strtod never produce (they only make quiet NaN's), and an undefined
+ * string holds NULL, so reading either takes a single load. Integers
+ * use every bit pattern, so that set keeps a separate flag per
+ * variable instead.
+ */
+
+#define VARCOUNT (26 * 27)
+#define VARCELL_UNDEFINED 0x7ff0000000000badULL
+
+typedef union varcell varcell;
+typedef struct vartable vartable;
+
+union varcell
+{
+    double number;
+    int64_t integer;
+    strobj *string;
+    uint64_t bits;
+};
+
+struct vartable
+{
+    varcell cells[3 * VARCOUNT];
+    unsigned char integer_defined[VARCOUNT];
+};
+
+extern void vartable_init(vartable *vars);
+extern void vartable_clear(vartable *vars);
+
+/* Returns the type of value the variable in slot holds
+ */
+static inline valuetype vartable_type(int slot)
+{
+    if (slot >= 2 * VARCOUNT) {
+        return TYPE_INTEGER;
+    }
+    return slot >= VARCOUNT ? TYPE_STRING : TYPE_NUMBER;
+}
+
+/* Returns the cell for a slot, or NULL if the variable is undefined
+ */
+static inline varcell *vartable_cell(vartable *vars, int slot)
+{
+    varcell *cell = &vars->cells[slot];
+    
+    if (slot < VARCOUNT) {
+        return cell->bits == VARCELL_UNDEFINED ? NULL : cell;
+    }
+    if (slot < 2 * VARCOUNT) {
+        return cell->string == NULL ? NULL : cell;
+    }
+    return vars->integer_defined[slot - 2 * VARCOUNT] ? cell : NULL;
+}
+
+/* Copy a variable into val. Returns 0 if it's undefined.
+ */
+static inline int vartable_get(vartable *vars, int slot, value *val)
+{
+    varcell *cell = &vars->cells[slot];
+    
+    if (slot < VARCOUNT) {
+        if (cell->bits == VARCELL_UNDEFINED) {
+            return 0;
+        }
+        value_set_number(val, cell->number);
+    } else if (slot < 2 * VARCOUNT) {
+        if (cell->string == NULL) {
+            return 0;
+        }
+        value_set_string(val, strobj_retain(cell->string));
+    } else {
+        if (!vars->integer_defined[slot - 2 * VARCOUNT]) {
+            return 0;
+        }
+        value_set_integer(val, cell->integer);
+    }
+    
+    basic_counters.value_copies++;
+    return 1;
+}
+
+/* Set a variable, taking over any string held by val. val must
+ * already have the variable's type.
+ */
+static inline void vartable_set(vartable *vars, int slot, value *val)
+{
+    varcell *cell = &vars->cells[slot];
+    
+    if (slot < VARCOUNT) {
+        cell->number = val->number;
+    } else if (slot < 2 * VARCOUNT) {
+        if (cell->string) {
+            strobj_release(cell->string);
+        }
+        cell->string = val->string;
+    } else {
+        cell->integer = val->integer;
+        vars->integer_defined[slot - 2 * VARCOUNT] = 1;
+    }
+}
+
+#endif /* vartable_h */
@@ -0,0 +1,441 @@
+#include <string.h>
+
+#include "builtins.h"
+#include "compile.h"
+#include "counters.h"
+#include "expression.h"
+#include "for.h"
+#include "gosub.h"
+#include "output.h"
+#include "parser.h"
+#include "print.h"
+#include "profile.h"
+#include "runtime.h"
+#include "safemem.h"
+#include "scope.h"
+#include "statement.h"
+#include "strobj.h"
+#include "value.h"
+#include "vartable.h"
+#include "vm.h"
+
+static void clear_stack(value *stack, value *sp);
+
+/* Run compiled code until it ends or a runtime error occurs
+ *
+ * The value stack holds values by value; a string on the stack is
+ * owned by its stack slot.
+ */
+void vm_run(runtime *rt, bytecode *bc)
+{
+    value *stack = safe_calloc(bc->max_stack + 1, sizeof(value));
+    value *sp = stack;
+    instr *code = bc->code;
+    instr *ip = code;
+    statement *stmt = NULL;
+    statement *target = NULL;
+    output *out = runtime_get_output(rt);
+    vartable *vars = runtime_vars(rt);
+    varcell *cell;
+    scope_stack *scopes = runtime_scope_stack(rt);
+    scope *top;
+    for_scope *loop;
+    uint64_t now;
+    uint64_t stmt_start = 0;
+
+    while (1) {
+        switch (ip->op) {
+        case OP_STMT:
+            basic_counters.statements++;
+            stmt = ip->u.stmt;
+            ip++;
+            break;
+
+        case OP_PROFILE_STMT:
+            /* charge the time since the last statement started to it */
+            now = profile_clock();
+            if (stmt) {
+                stmt->nsecs += now - stmt_start;
+            }
+            stmt_start = now;
+            basic_counters.statements++;
+            stmt = ip->u.stmt;
+            stmt->hits++;
+            ip++;
+            break;
+
+        case OP_EXEC:
+            runtime_set_current_statement(rt, stmt);
+            stmt->body->execute(stmt->body, rt);
+            if (runtime_check_error(rt, stmt)) {
+                goto done;
+            }
+            target = runtime_take_goto(rt);
+            ip = target ? code + target->pc : ip + 1;
+            break;
+
+        case OP_END:
+            goto done;
+
+        case OP_PUSH_NUM:
+            sp->type = TYPE_NUMBER;
+            sp->number = ip->u.number;
+            sp++;
+            ip++;
+            break;
+
+        case OP_PUSH_INT:
+            sp->type = TYPE_INTEGER;
+            sp->integer = ip->u.integer;
+            sp++;
+            ip++;
+            break;
+
+        case OP_PUSH_STR:
+            sp->type = TYPE_STRING;
+            sp->string = strobj_retain(ip->u.str);
+            sp++;
+            ip++;
+            break;
+
+        case OP_LOAD:
+            if (!vartable_get(vars, ip->arg, sp)) {
+                runtime_set_error(rt, "VARIABLE %s IS NOT DEFINED", ip->u.string);
+                goto error;
+            }
+            sp++;
+            ip++;
+            break;
+
+        case OP_STORE:
+            sp--;
+            vartable_set(vars, ip->arg, sp);
+            ip++;
+            break;
+
+        case OP_APPEND:
+            sp--;
+            if ((cell = vartable_cell(vars, ip->arg)) == NULL) {
+                runtime_set_error(rt, "VARIABLE %s IS NOT DEFINED", ip->u.string);
+                value_clear(sp);
+                goto error;
+            }
+            cell->string = strobj_append(cell->string, sp->string);
+            value_clear(sp);
+            ip++;
+            break;
+
+        case OP_CALL:
+            {
+                value *args = sp - ip->arg;
+                value ret;
+
+                int ok = builtin_execute(rt, ip->u.fn, args, &ret);
+                clear_stack(args, sp);
+                sp = args;
+                if (!ok) {
+                    goto error;
+                }
+
+                *sp++ = ret;
+                ip++;
+            }
+            break;
+
+        case OP_ADD:
+            sp--;
+            sp[-1].number += sp->number;
+            ip++;
+            break;
+
+        case OP_SUB:
+            sp--;
+            sp[-1].number -= sp->number;
+            ip++;
+            break;
+
+        case OP_MUL:
+            sp--;
+            sp[-1].number *= sp->number;
+            ip++;
+            break;
+
+        case OP_DIV:
+            sp--;
+            sp[-1].number /= sp->number;
+            ip++;
+            break;
+
+        case OP_LT:
+            sp--;
+            sp[-1].type = TYPE_BOOLEAN;
+            sp[-1].boolean = sp[-1].number < sp->number;
+            ip++;
+            break;
+
+        case OP_GT:
+            sp--;
+            sp[-1].type = TYPE_BOOLEAN;
+            sp[-1].boolean = sp[-1].number > sp->number;
+            ip++;
+            break;
+
+        case OP_LE:
+            sp--;
+            sp[-1].type = TYPE_BOOLEAN;
+            sp[-1].boolean = sp[-1].number <= sp->number;
+            ip++;
+            break;
+
+        case OP_GE:
+            sp--;
+            sp[-1].type = TYPE_BOOLEAN;
+            sp[-1].boolean = sp[-1].number >= sp->number;
+            ip++;
+            break;
+
+        case OP_EQ:
+            sp--;
+            sp[-1].type = TYPE_BOOLEAN;
+            sp[-1].boolean = sp[-1].number == sp->number;
+            ip++;
+            break;
+
+        case OP_NE:
+            sp--;
+            sp[-1].type = TYPE_BOOLEAN;
+            sp[-1].boolean = sp[-1].number != sp->number;
+            ip++;
+            break;
+
+        case OP_ADD_INT:
+            sp--;
+            if (__builtin_add_overflow(sp[-1].integer, sp->integer, &sp[-1].integer)) {
+                goto overflow;
+            }
+            ip++;
+            break;
+
+        case OP_SUB_INT:
+            sp--;
+            if (__builtin_sub_overflow(sp[-1].integer, sp->integer, &sp[-1].integer)) {
+                goto overflow;
+            }
+            ip++;
+            break;
+
+        case OP_MUL_INT:
+            sp--;
+            if (__builtin_mul_overflow(sp[-1].integer, sp->integer, &sp[-1].integer)) {
+                goto overflow;
+            }
+            ip++;
+            break;
+
+        case OP_COMPARE_INT:
+            {
+                sp--;
+                int64_t left = sp[-1].integer;
+                int64_t right = sp->integer;
+                int result;
+                
+                switch (ip->arg) {
+                case TOK_LESSTHAN:      result = left < right; break;
+                case TOK_GREATERTHAN:   result = left > right; break;
+                case TOK_LESSEQUALS:    result = left <= right; break;
+                case TOK_GREATEREQUALS: result = left >= right; break;
+                case TOK_EQUALS:        result = left == right; break;
+                default:                result = left != right; break;
+                }
+                
+                sp[-1].type = TYPE_BOOLEAN;
+                sp[-1].boolean = result;
+                ip++;
+            }
+            break;
+
+        case OP_NEG_INT:
+            if (sp[-1].integer == INT64_MIN) {
+                goto overflow;
+            }
+            sp[-1].integer = -sp[-1].integer;
+            ip++;
+            break;
+
+        case OP_TO_NUMBER:
+            sp[-1].type = TYPE_NUMBER;
+            sp[-1].number = (double)sp[-1].integer;
+            ip++;
+            break;
+
+        case OP_TO_INTEGER:
+            if (!expression_number_to_integer(sp[-1].number, &sp[-1].integer)) {
+                goto overflow;
+            }
+            sp[-1].type = TYPE_INTEGER;
+            ip++;
+            break;
+
+        case OP_CONCAT:
+        case OP_COMPARE_STRINGS:
+            {
+                /* string operators share the tree walker's code */
+                value ret;
+                sp--;
+                expression_string_binop(ip->arg, &sp[-1], sp, &ret);
+                sp[-1] = ret;
+                ip++;
+            }
+            break;
+
+        case OP_NEG:
+            sp[-1].number = -sp[-1].number;
+            ip++;
+            break;
+
+        case OP_PRINT:
+            sp--;
+            print_value(out, sp);
+            value_clear(sp);
+            ip++;
+            break;
+
+        case OP_PRINT_TAB:
+            output_print(out, "\t");
+            ip++;
+            break;
+
+        case OP_PRINT_NL:
+            output_print(out, "\n");
+            ip++;
+            break;
+
+        case OP_JUMP:
+            ip = code + ip->u.target;
+            break;
+
+        case OP_JUMP_FALSE:
+            sp--;
+            ip = sp->boolean ? ip + 1 : code + ip->u.target;
+            break;
+
+        case OP_GOTO:
+            basic_counters.vm_jumps++;
+            ip = code + ip->u.target;
+            break;
+
+        case OP_GOSUB:
+            if (!gosub_call(rt, stmt->next)) {
+                goto error;
+            }
+            basic_counters.vm_jumps++;
+            ip = code + ip->u.target;
+            break;
+
+        case OP_RETURN:
+            if (!gosub_return(rt, &target)) {
+                goto error;
+            }
+            basic_counters.vm_jumps++;
+            ip = target ? code + target->pc : code + bc->used - 1;
+            break;
+
+        case OP_FOR:
+            {
+                /* FOR evaluates its expressions in the order limit, step,
+                 * start, so start is on top
+                 */
+                sp -= 3;
+                if (!for_enter(rt, ip->arg, ip->u.string, &sp[2], &sp[0], &sp[1], stmt->next)) {
+                    goto error;
+                }
+                ip++;
+            }
+            break;
+
+        case OP_NEXT:
+            if (!for_next(rt, ip->arg, ip->u.string, &target)) {
+                goto error;
+            }
+            basic_counters.vm_jumps += target != NULL;
+            ip = target ? code + target->pc : ip + 1;
+            break;
+        
+        case OP_NEXT_NUM:
+            /* the compiler paired this NEXT with the FOR whose body is at
+             * u.target; if that isn't the innermost loop, leave it to the
+             * OP_NEXT which follows
+             */
+            top = scope_stack_top(scopes);
+            if (top == NULL || top->type != SCOPE_FOR || top->u.loop.loop_pc != ip->u.target) {
+                ip++;
+                break;
+            }
+            loop = &top->u.loop;
+            cell = &vars->cells[ip->arg];
+            cell->number += loop->step.number;
+            if (loop->step.number < 0 ? cell->number < loop->limit.number : cell->number > loop->limit.number) {
+                scope_stack_pop(scopes);
+                ip += 2;
+            } else {
+                basic_counters.vm_jumps++;
+                ip = code + ip->u.target;
+            }
+            break;
+        
+        case OP_NEXT_INT:
+            {
+                top = scope_stack_top(scopes);
+                if (top == NULL || top->type != SCOPE_FOR || top->u.loop.loop_pc != ip->u.target) {
+                    ip++;
+                    break;
+                }
+                loop = &top->u.loop;
+                cell = &vars->cells[ip->arg];
+                
+                /* as in for_next, stepping past the largest or smallest
+                 * integer also ends the loop
+                 */
+                int64_t delta = loop->step.integer;
+                int64_t next;
+                int done = __builtin_add_overflow(cell->integer, delta, &next);
+                
+                if (!done) {
+                    cell->integer = next;
+                    done = delta < 0 ? next < loop->limit.integer : next > loop->limit.integer;
+                }
+                
+                if (done) {
+                    scope_stack_pop(scopes);
+                    ip += 2;
+                } else {
+                    basic_counters.vm_jumps++;
+                    ip = code + ip->u.target;
+                }
+            }
+            break;
+        }
+    }
+
+overflow:
+    runtime_set_error(rt, "INTEGER OVERFLOW");
+
+error:
+    runtime_check_error(rt, stmt);
+
+done:
+    if (stmt_start && stmt) {
+        stmt->nsecs += profile_clock() - stmt_start;
+    }
+    clear_stack(stack, sp);
+    free(stack);
+}
+
+/* Release anything owned by a range of stack slots
+ */
+void clear_stack(value *stack, value *sp)
+{
+    for (value *p = stack; p < sp; p++) {
+        value_clear(p);
+    }
+}
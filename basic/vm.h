@@ -0,0 +1,9 @@
+#ifndef vm_h
+#define vm_h
+
+typedef struct bytecode bytecode;
+typedef struct runtime runtime;
+
+extern void vm_run(runtime *rt, bytecode *bc);
+
+#endif /* vm_h */
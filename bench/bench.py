@@ -0,0 +1,181 @@
+#!/usr/bin/env python3
+"""Runs the BASIC benchmark corpus.
+
+Every programs/NAME.bas is run once and its output checked against
+programs/NAME.out, then run --runs more times under --stats=json. For
+each program this reports the median wall time, statements executed
+per second (from the interpreter's own counters), peak RSS and how far
+the median is from the one stored in the baseline file.
+
+A program with a REM TIMED WITH N = n line is checked as written, but
+timed with its LET N = line set to n, so that its golden output can stay
+small.
+
+--rss PROGRAM instead runs PROGRAM with its LET N = line set to a small
+and then a large N, and fails if peak RSS grows with N. --rss-repl does
+the same for a REPL session which keeps replacing one line with a
+different string literal.
+"""
+
+import argparse
+import glob
+import json
+import os
+import re
+import statistics
+import subprocess
+import sys
+import tempfile
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+# the N values --rss compares, and how much more memory the larger may use
+RSS_SIZES = (100000, 1000000)
+RSS_SLACK_KB = 512
+
+# how many times --rss-repl replaces the line
+REPL_SIZES = (5000, 50000)
+
+
+def run(opts, path, repl_input=None):
+    """Run one program, or the REPL on repl_input if path is None.
+    Returns (stdout, counters, wall secs, peak RSS KB)."""
+    args = [opts.runstat, opts.interp] + ([opts.engine] if opts.engine else [])
+    args += ['--stats=json'] + ([path] if path else [])
+    proc = subprocess.run(args, input=(repl_input or '').encode(),
+                          stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    lines = proc.stderr.decode(errors='replace').strip().splitlines()
+    _, wall, rss = lines[-1].split()
+    counters = json.loads(lines[-2]) if len(lines) > 1 and lines[-2].startswith('{') else {}
+    return proc.stdout, counters, float(wall), int(rss)
+
+
+def set_n(text, n):
+    """Returns program text with its LET N = line set to n."""
+    return re.sub(r'^(\d+ LET N = )\d+$', r'\g<1>%d' % n, text, flags=re.M)
+
+
+def timed_text(path):
+    """Returns the text of path with N set for timing, or None if it
+    has no REM TIMED WITH N = line and is timed as it is."""
+    with open(path) as fp:
+        text = fp.read()
+    m = re.search(r'^\d+ REM TIMED WITH N = (\d+)$', text, re.M)
+    return set_n(text, int(m.group(1))) if m else None
+
+
+def check_rss(opts, path):
+    """Run path at each of RSS_SIZES. Returns 0 if peak RSS stays flat."""
+    with open(path) as fp:
+        text = fp.read()
+    if not re.search(r'^\d+ LET N = \d+$', text, re.M):
+        print('%s has no LET N = line' % path)
+        return 1
+
+    peaks = []
+    for n in RSS_SIZES:
+        with tempfile.NamedTemporaryFile('w', suffix='.bas') as tmp:
+            tmp.write(set_n(text, n))
+            tmp.flush()
+            _, _, wall, rss = run(opts, tmp.name)
+        print('N=%-10d %10.1f ms %10d KB' % (n, 1000 * wall, rss))
+        peaks.append(rss)
+
+    return check_flat(peaks)
+
+
+def check_repl_rss(opts):
+    """Replace line 10 in the REPL with a new string literal each time,
+    as many times as each of REPL_SIZES. Returns 0 if peak RSS stays flat."""
+    peaks = []
+    for n in REPL_SIZES:
+        lines = ''.join('10 PRINT "%s%d"\n' % ('X' * 150, i) for i in range(n))
+        _, _, wall, rss = run(opts, None, lines + 'RUN\n')
+        print('LINES=%-6d %10.1f ms %10d KB' % (n, 1000 * wall, rss))
+        peaks.append(rss)
+
+    return check_flat(peaks)
+
+
+def check_flat(peaks):
+    """Returns 0 if the last peak RSS is within RSS_SLACK_KB of the first."""
+    if peaks[-1] > peaks[0] + RSS_SLACK_KB:
+        print('peak RSS grew by %d KB' % (peaks[-1] - peaks[0]))
+        return 1
+    return 0
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument('--interp', default=os.path.join(HERE, 'basic'))
+    ap.add_argument('--runstat', default=os.path.join(HERE, 'runstat'))
+    ap.add_argument('--engine', default='', help='extra interpreter flag, e.g. --tree')
+    ap.add_argument('--runs', type=int, default=5)
+    ap.add_argument('--baseline', help='JSON file of baseline median wall times')
+    ap.add_argument('--update-baseline', action='store_true')
+    ap.add_argument('--check', action='store_true', help='only check golden outputs')
+    ap.add_argument('--rss', metavar='PROGRAM', help='check that PROGRAM runs in flat memory')
+    ap.add_argument('--rss-repl', action='store_true',
+                    help='check that replacing a REPL line frees the old one')
+    ap.add_argument('programs', nargs='*')
+    opts = ap.parse_args()
+
+    if opts.rss:
+        return check_rss(opts, opts.rss)
+    if opts.rss_repl:
+        return check_repl_rss(opts)
+
+    programs = opts.programs or sorted(glob.glob(os.path.join(HERE, 'programs', '*.bas')))
+    baseline = {}
+    if opts.baseline and os.path.exists(opts.baseline):
+        with open(opts.baseline) as fp:
+            baseline = json.load(fp)
+
+    failed = 0
+    results = {}
+    if not opts.check:
+        print('%-10s %10s %14s %10s %10s' % ('PROGRAM', 'WALL MS', 'STMTS/SEC', 'RSS KB', 'VS BASE'))
+
+    for path in programs:
+        name = os.path.splitext(os.path.basename(path))[0]
+        golden = os.path.splitext(path)[0] + '.out'
+
+        out, _, _, _ = run(opts, path)
+        with open(golden, 'rb') as fp:
+            if out != fp.read():
+                print('%-10s output differs from %s' % (name, os.path.basename(golden)))
+                failed += 1
+                continue
+        if opts.check:
+            print('%-10s ok' % name)
+            continue
+
+        walls, rss, stmts = [], 0, 0
+        text = timed_text(path)
+        with tempfile.NamedTemporaryFile('w', suffix='.bas') as tmp:
+            if text:
+                tmp.write(text)
+                tmp.flush()
+            for _ in range(opts.runs):
+                _, counters, wall, peak = run(opts, tmp.name if text else path)
+                walls.append(wall)
+                rss = max(rss, peak)
+                stmts = counters.get('statements', 0)
+
+        median = statistics.median(walls)
+        results[name] = median
+        vs = ''
+        if name in baseline:
+            vs = '%+.1f%%' % (100.0 * (median - baseline[name]) / baseline[name])
+        print('%-10s %10.1f %14.0f %10d %10s' % (name, 1000 * median, stmts / median, rss, vs))
+
+    if opts.update_baseline and opts.baseline and not failed:
+        with open(opts.baseline, 'w') as fp:
+            json.dump(results, fp, indent=2, sort_keys=True)
+            fp.write('\n')
+
+    return 1 if failed else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
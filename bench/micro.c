@@ -0,0 +1,580 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "expression.h"
+#include "keyword.h"
+#include "numformat.h"
+#include "numparse.h"
+#include "output.h"
+#include "parser.h"
+#include "program.h"
+#include "runtime.h"
+#include "safemem.h"
+#include "statement.h"
+#include "strobj.h"
+#include "value.h"
+
+/* micro [-w warmups] [-r repetitions] [name...]
+ *
+ * Times interpreter primitives in isolation. Each benchmark is run
+ * for a number of untimed warm-up repetitions, then timed for each
+ * repetition; the report gives the time per operation at several
+ * percentiles of the repetitions. Names on the command line select
+ * the benchmarks whose names contain them.
+ */
+
+typedef struct micro micro;
+
+struct micro
+{
+    const char *name;
+    int size;                           /* passed to setup */
+    int ops;                            /* operations done by each call to run */
+    void *(*setup)(int size);
+    void (*reset)(void *ctx);           /* optional; untimed, before each repetition */
+    void (*run)(void *ctx, int ops);
+    void (*teardown)(void *ctx);
+};
+
+typedef struct eval_ctx eval_ctx;
+
+struct eval_ctx
+{
+    parser *prs;
+    program *pgm;
+    runtime *rt;
+    arena *nodes;
+    expression *exp;
+};
+
+typedef struct program_ctx program_ctx;
+
+struct program_ctx
+{
+    parser *prs;
+    program *pgm;
+    statement **stmts;
+    int count;
+};
+
+static void *setup_none(int size);
+static void teardown_none(void *ctx);
+static void run_value_alloc(void *ctx, int ops);
+static void *setup_string(int size);
+static void run_value_copy(void *ctx, int ops);
+static void teardown_string(void *ctx);
+static void *setup_eval_number(int size);
+static void *setup_eval_integer(int size);
+static void *setup_eval_string(int size);
+static void *setup_eval_builtin(int size);
+static void *setup_eval(const char *text);
+static void run_eval(void *ctx, int ops);
+static void teardown_eval(void *ctx);
+static void *setup_program(int size);
+static void reset_link(void *ctx);
+static void run_link(void *ctx, int ops);
+static void reset_insert(void *ctx);
+static void run_insert(void *ctx, int ops);
+static void teardown_program(void *ctx);
+static void run_kw_find(void *ctx, int ops);
+static void *setup_numbers(int size);
+static void run_numformat(void *ctx, int ops);
+static void run_snprintf_trim(void *ctx, int ops);
+static void teardown_numbers(void *ctx);
+static void *setup_number_text(int size);
+static void run_numparse(void *ctx, int ops);
+static void run_sscanf(void *ctx, int ops);
+static void *setup_output(int size);
+static void run_output(void *ctx, int ops);
+static void teardown_output(void *ctx);
+static void run_micro(micro *m, int warmups, int reps);
+static uint64_t now_ns();
+static int compare_doubles(const void *l, const void *r);
+
+static micro micros[] =
+{
+    { "value_alloc_number/value_free", 0, 10000, &setup_none, NULL, &run_value_alloc, &teardown_none },
+    { "value_copy/value_clear string", 0, 10000, &setup_string, NULL, &run_value_copy, &teardown_string },
+    { "expression_evaluate number", 0, 1000, &setup_eval_number, NULL, &run_eval, &teardown_eval },
+    { "expression_evaluate integer", 0, 1000, &setup_eval_integer, NULL, &run_eval, &teardown_eval },
+    { "expression_evaluate string", 0, 1000, &setup_eval_string, NULL, &run_eval, &teardown_eval },
+    { "expression_evaluate builtin", 0, 1000, &setup_eval_builtin, NULL, &run_eval, &teardown_eval },
+    { "program_link GOTO 100", 100, 100, &setup_program, &reset_link, &run_link, &teardown_program },
+    { "program_link GOTO 1000", 1000, 1000, &setup_program, &reset_link, &run_link, &teardown_program },
+    { "program_link GOTO 10000", 10000, 10000, &setup_program, &reset_link, &run_link, &teardown_program },
+    { "program_link unchanged 10000", 10000, 10000, &setup_program, NULL, &run_link, &teardown_program },
+    { "program_insert_statement 100", 100, 100, &setup_program, &reset_insert, &run_insert, &teardown_program },
+    { "program_insert_statement 1000", 1000, 1000, &setup_program, &reset_insert, &run_insert, &teardown_program },
+    { "program_insert_statement 10000", 10000, 10000, &setup_program, &reset_insert, &run_insert, &teardown_program },
+    { "kw_find", 0, 1000, &setup_none, NULL, &run_kw_find, &teardown_none },
+    { "output_print", 0, 1000, &setup_output, NULL, &run_output, &teardown_output },
+    { "numformat_double", 1024, 1024, &setup_numbers, NULL, &run_numformat, &teardown_numbers },
+    { "snprintf %lf and trim zeros", 1024, 1024, &setup_numbers, NULL, &run_snprintf_trim, &teardown_numbers },
+    { "numparse_double", 1024, 1024, &setup_number_text, NULL, &run_numparse, &teardown_numbers },
+    { "sscanf %lf", 1024, 1024, &setup_number_text, NULL, &run_sscanf, &teardown_numbers },
+
+    { NULL }
+};
+
+/* Keywords to look up, including one which isn't there
+ */
+static const char *kw_names[] = { "PRINT", "LET", "GOTO", "IF", "NEXT", "SAVE", "RETURN", "NOSUCH" };
+
+/* Results are written to the caller's stdout, which output_print is
+ * redirected away from
+ */
+static FILE *report;
+
+/* Keep the compiler from discarding work whose result isn't used
+ */
+static volatile double sink;
+
+int main(int argc, const char * argv[])
+{
+    int warmups = 3;
+    int reps = 30;
+    int arg = 1;
+
+    for (; arg < argc && argv[arg][0] == '-'; arg++) {
+        if (strcmp(argv[arg], "-w") == 0 && arg + 1 < argc) {
+            warmups = atoi(argv[++arg]);
+        } else if (strcmp(argv[arg], "-r") == 0 && arg + 1 < argc) {
+            reps = atoi(argv[++arg]);
+        } else {
+            fprintf(stderr, "usage: micro [-w warmups] [-r repetitions] [name...]\n");
+            return 1;
+        }
+    }
+
+    if (reps < 1) {
+        reps = 1;
+    }
+
+    report = fdopen(dup(STDOUT_FILENO), "w");
+    if (report == NULL || freopen("/dev/null", "w", stdout) == NULL) {
+        perror("micro");
+        return 1;
+    }
+
+    fprintf(report, "%-32s %10s %10s %10s %10s   (ns per op, %d reps)\n", "BENCHMARK", "MIN", "P50", "P90", "P99", reps);
+
+    for (micro *m = &micros[0]; m->name; m++) {
+        int selected = arg == argc;
+        for (int i = arg; i < argc && !selected; i++) {
+            selected = strstr(m->name, argv[i]) != NULL;
+        }
+
+        if (selected) {
+            run_micro(m, warmups, reps);
+        }
+    }
+
+    fclose(report);
+
+    return 0;
+}
+
+/* Run one benchmark and report its percentiles
+ */
+void run_micro(micro *m, int warmups, int reps)
+{
+    void *ctx = m->setup(m->size);
+    double *times = safe_calloc(reps, sizeof(double));
+
+    for (int i = -warmups; i < reps; i++) {
+        if (m->reset) {
+            m->reset(ctx);
+        }
+
+        uint64_t start = now_ns();
+        m->run(ctx, m->ops);
+        uint64_t end = now_ns();
+
+        if (i >= 0) {
+            times[i] = (double)(end - start) / m->ops;
+        }
+    }
+
+    m->teardown(ctx);
+
+    qsort(times, reps, sizeof(double), &compare_doubles);
+    fprintf(report, "%-32s %10.1f %10.1f %10.1f %10.1f\n",
+        m->name,
+        times[0],
+        times[reps / 2],
+        times[(reps * 9) / 10],
+        times[(reps * 99) / 100]);
+    fflush(report);
+
+    free(times);
+}
+
+/* Monotonic time in nanoseconds
+ */
+uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/* qsort comparison for doubles
+ */
+int compare_doubles(const void *l, const void *r)
+{
+    double dl = *(const double *)l;
+    double dr = *(const double *)r;
+
+    return dl < dr ? -1 : dl > dr;
+}
+
+/* For benchmarks which need no state
+ */
+void *setup_none(int size)
+{
+    return NULL;
+}
+
+void teardown_none(void *ctx)
+{
+}
+
+/* value_alloc_number and value_free
+ */
+void run_value_alloc(void *ctx, int ops)
+{
+    for (int i = 0; i < ops; i++) {
+        value *v = value_alloc_number(i);
+        sink = v->number;
+        value_free(v);
+    }
+}
+
+/* Copying and releasing a string value, which shares the text
+ */
+void *setup_string(int size)
+{
+    value *v = safe_calloc(1, sizeof(value));
+    const char *text = "THE QUICK BROWN FOX JUMPS OVER THE LAZY DOG";
+    value_set_string(v, strobj_from_cstr(text));
+    return v;
+}
+
+void run_value_copy(void *ctx, int ops)
+{
+    value *src = ctx;
+
+    for (int i = 0; i < ops; i++) {
+        value copy;
+        value_copy(&copy, src);
+        sink = copy.string->len;
+        value_clear(&copy);
+    }
+}
+
+void teardown_string(void *ctx)
+{
+    value_free(ctx);
+}
+
+/* Representative expression trees. Variables are set up by
+ * setup_eval.
+ */
+void *setup_eval_number(int size)
+{
+    return setup_eval("A * B + C / 2 - (A - B) * 0.5");
+}
+
+void *setup_eval_integer(int size)
+{
+    return setup_eval("I% * J% + K% - (I% - J%) * 3");
+}
+
+void *setup_eval_string(int size)
+{
+    return setup_eval("A$ + \"-\" + B$ < B$ + A$");
+}
+
+void *setup_eval_builtin(int size)
+{
+    return setup_eval("SIN(A) * COS(B) + ABS(C - A)");
+}
+
+/* Parse an expression and define the variables it uses by running a
+ * few statements
+ */
+void *setup_eval(const char *text)
+{
+    static const char *init[] = {
+        "LET A = 1.5", "LET B = 2.25", "LET C = 7",
+        "LET I% = 12", "LET J% = 34", "LET K% = 56",
+        "LET A$ = \"HELLO\"", "LET B$ = \"WORLD\"",
+    };
+
+    eval_ctx *ctx = safe_calloc(1, sizeof(eval_ctx));
+    ctx->prs = parser_alloc();
+    ctx->pgm = program_alloc();
+    ctx->rt = runtime_alloc(ctx->pgm);
+
+    for (int i = 0; i < sizeof(init) / sizeof(init[0]); i++) {
+        char line[80];
+        statement *stmt = NULL;
+
+        strcpy(line, init[i]);
+        parser_parse_repl_line(ctx->prs, line, ctx->pgm, &stmt);
+        runtime_execute_statement(ctx->rt, stmt);
+        statement_free(stmt);
+    }
+
+    /* point the parser at the expression by hand, as the parser has no
+     * entry point for a bare expression
+     */
+    parser *prs = ctx->prs;
+    size_t n = strlen(text);
+    prs->line_buffer = safe_realloc(prs->line_buffer, n + 1);
+    prs->line_buffer_size = (int)(n + 1);
+    strcpy(prs->line_buffer, text);
+    prs->in_line_buffer = (int)n;
+    prs->parse_index = 0;
+    prs->nodes = ctx->nodes = arena_alloc();
+    parse_next_token(prs);
+    ctx->exp = expression_parse(prs);
+    prs->nodes = NULL;
+    
+    if (ctx->exp == NULL) {
+        fprintf(stderr, "could not parse %s: %s\n", text, prs->error_msg);
+        exit(1);
+    }
+
+    return ctx;
+}
+
+void run_eval(void *ctx, int ops)
+{
+    eval_ctx *ec = ctx;
+
+    for (int i = 0; i < ops; i++) {
+        value result;
+        expression_evaluate(ec->exp, ec->rt, &result);
+        sink = result.number;
+        value_clear(&result);
+    }
+}
+
+void teardown_eval(void *ctx)
+{
+    eval_ctx *ec = ctx;
+
+    expression_free(ec->exp);
+    arena_release(ec->nodes);
+    runtime_free(ec->rt);
+    program_free(ec->pgm);
+    parser_free(ec->prs);
+    free(ec);
+}
+
+/* A program of size lines, each a GOTO to a line some way ahead of it
+ * (wrapping round), so that linking has to look up every line
+ */
+void *setup_program(int size)
+{
+    program_ctx *ctx = safe_calloc(1, sizeof(program_ctx));
+    ctx->prs = parser_alloc();
+    ctx->pgm = program_alloc();
+    ctx->count = size;
+    ctx->stmts = safe_calloc(size, sizeof(statement *));
+
+    for (int i = 0; i < size; i++) {
+        char line[40];
+        statement *stmt = NULL;
+
+        snprintf(line, sizeof(line), "%d GOTO %d", 10 * (i + 1), 10 * ((i * 7919) % size + 1));
+        parser_parse_repl_line(ctx->prs, line, ctx->pgm, &stmt);
+    }
+
+    int i = 0;
+    for (statement *p = ctx->pgm->head; p; p = p->next) {
+        ctx->stmts[i++] = p;
+    }
+
+    return ctx;
+}
+
+void reset_link(void *ctx)
+{
+    program_ctx *pc = ctx;
+    pc->pgm->linked = 0;
+}
+
+/* Resolve every GOTO in the program
+ */
+void run_link(void *ctx, int ops)
+{
+    program_ctx *pc = ctx;
+    sink = program_link(pc->pgm);
+}
+
+/* Take the statements out of the program so they can be inserted again
+ */
+void reset_insert(void *ctx)
+{
+    program_ctx *pc = ctx;
+
+    for (int i = 0; i < pc->count; i++) {
+        pc->stmts[i]->prev = NULL;
+        pc->stmts[i]->next = NULL;
+    }
+    pc->pgm->head = NULL;
+    pc->pgm->tail = NULL;
+    pc->pgm->count = 0;
+    pc->pgm->linked = 0;
+}
+
+/* Insert every statement in line number order, as loading a program does
+ */
+void run_insert(void *ctx, int ops)
+{
+    program_ctx *pc = ctx;
+
+    for (int i = 0; i < pc->count; i++) {
+        program_insert_statement(pc->pgm, pc->stmts[i]);
+    }
+}
+
+void teardown_program(void *ctx)
+{
+    program_ctx *pc = ctx;
+
+    program_free(pc->pgm);
+    parser_free(pc->prs);
+    free(pc->stmts);
+    free(pc);
+}
+
+/* Keyword lookup, mostly of keywords which exist
+ */
+void run_kw_find(void *ctx, int ops)
+{
+    int n = sizeof(kw_names) / sizeof(kw_names[0]);
+
+    for (int i = 0; i < ops; i++) {
+        sink = kw_find(kw_names[i % n]) != NULL;
+    }
+}
+
+/* A mix of the numbers programs print: whole numbers, short and long
+ * fractions, and large and small magnitudes
+ */
+void *setup_numbers(int size)
+{
+    double *numbers = safe_calloc(size, sizeof(double));
+
+    for (int i = 0; i < size; i++) {
+        switch (i % 4) {
+        case 0: numbers[i] = i; break;
+        case 1: numbers[i] = i / 8.0; break;
+        case 2: numbers[i] = i / 7.0; break;
+        case 3: numbers[i] = (i % 8 < 4 ? 1e20 : 1e-9) * i / 3.0; break;
+        }
+    }
+
+    return numbers;
+}
+
+void run_numformat(void *ctx, int ops)
+{
+    double *numbers = ctx;
+    char buf[NUMFORMAT_SIZE];
+
+    for (int i = 0; i < ops; i++) {
+        sink = numformat_double(numbers[i], buf);
+    }
+}
+
+/* What PRINT did before numformat: six decimal places, then the
+ * trailing zeros taken off
+ */
+void run_snprintf_trim(void *ctx, int ops)
+{
+    double *numbers = ctx;
+    char buf[400];
+
+    for (int i = 0; i < ops; i++) {
+        int len = snprintf(buf, sizeof(buf), "%lf", numbers[i]);
+        char *p = buf + len;
+        while (p > buf && p[-1] == '0') {
+            p--;
+        }
+        if (p > buf && p[-1] == '.') {
+            p--;
+        }
+        *p = '\0';
+        sink = p - buf;
+    }
+}
+
+void teardown_numbers(void *ctx)
+{
+    free(ctx);
+}
+
+/* The same numbers as text, in fixed size slots
+ */
+void *setup_number_text(int size)
+{
+    double *numbers = setup_numbers(size);
+    char *text = safe_calloc(size, NUMFORMAT_SIZE);
+
+    for (int i = 0; i < size; i++) {
+        numformat_double(numbers[i], text + i * NUMFORMAT_SIZE);
+    }
+
+    free(numbers);
+    return text;
+}
+
+void run_numparse(void *ctx, int ops)
+{
+    char *text = ctx;
+    double number;
+
+    for (int i = 0; i < ops; i++) {
+        numparse_double(text + i * NUMFORMAT_SIZE, &number);
+        sink = number;
+    }
+}
+
+void run_sscanf(void *ctx, int ops)
+{
+    char *text = ctx;
+    double number;
+
+    for (int i = 0; i < ops; i++) {
+        sscanf(text + i * NUMFORMAT_SIZE, "%lf", &number);
+        sink = number;
+    }
+}
+
+/* Formatted output of a typical PRINT line
+ */
+void *setup_output(int size)
+{
+    return output_alloc();
+}
+
+void run_output(void *ctx, int ops)
+{
+    for (int i = 0; i < ops; i++) {
+        output_print(ctx, "%s%d\t%lf\n", "LINE ", i, i * 0.125);
+    }
+    fflush(stdout);
+}
+
+void teardown_output(void *ctx)
+{
+    output_free(ctx);
+}
@@ -0,0 +1,21 @@
+10 REM
+20 REM DOUBLY RECURSIVE FIBONACCI THROUGH GOSUB. THE ARGUMENT IS
+30 REM RESTORED ON THE WAY OUT RATHER THAN KEPT ON A STACK.
+40 REM
+50 FOR K = 1 TO 25
+60 LET N = K
+70 LET F = 0
+80 GOSUB 1000
+90 PRINT "FIB("; K; ") = "; F
+100 NEXT K
+110 GOTO 2000
+1000 IF N < 2 THEN 1100
+1010 LET N = N - 1
+1020 GOSUB 1000
+1030 LET N = N - 1
+1040 GOSUB 1000
+1050 LET N = N + 2
+1060 RETURN
+1100 LET F = F + N
+1110 RETURN
+2000 REM
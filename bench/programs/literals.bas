@@ -0,0 +1,18 @@
+10 REM
+20 REM NUMBER LITERALS ARE NUMBERS, EVEN WITHOUT A DECIMAL POINT; ONLY
+30 REM INTEGER VARIABLES AND WHAT THEY'RE MIXED WITH USE INTEGER ARITHMETIC
+40 REM
+50 PRINT 100000000000 * 100000000000
+60 LET A = 3000000000 * 4000000000
+70 PRINT A
+80 LET I% = 7
+90 PRINT I% * 3 + 1, I% / 2, I% + 0.5, I% = 7
+100 LET J% = 9223372036854775806
+110 PRINT J% + 1, -J% - 1
+120 LET N = 0
+130 FOR K = 1 TO 2000000
+140 LET N = N + K * 3000000000
+150 NEXT K
+160 PRINT N
+170 LET L% = -9223372036854775807 - 1
+180 PRINT L%, I% + -1, I% - -2
@@ -0,0 +1,15 @@
+10 REM
+20 REM NESTED FOR LOOPS DOING MIXED ARITHMETIC
+30 REM
+40 LET S = 0
+50 LET T% = 0
+60 FOR I = 1 TO 150
+70 FOR J = 1 TO 150
+80 FOR K = 1 TO 150
+90 LET S = S + I * J / K - (I - J) * 0.5
+100 LET T% = T% + I * J - K
+110 NEXT K
+120 NEXT J
+130 NEXT I
+140 PRINT "S = "; S
+150 PRINT "T% = "; T%
@@ -0,0 +1,10 @@
+10 REM
+20 REM PRINT-HEAVY OUTPUT WITH SEPARATORS AND TAB
+30 REM TIMED WITH N = 30000
+40 REM
+50 LET N = 300
+60 FOR I = 1 TO N
+70 PRINT "LINE "; I, I * I, I / 8
+80 LET Q% = I / 10
+90 PRINT TAB(I - Q% * 10); "*"; I
+100 NEXT I
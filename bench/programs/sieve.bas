@@ -0,0 +1,20 @@
+10 REM
+20 REM PRIME COUNT BY TRIAL DIVISION. THE LANGUAGE HAS NO ARRAYS, SO
+30 REM THIS STANDS IN FOR A SIEVE: INTEGER DIVIDES AND COMPARES IN A
+40 REM TIGHT LOOP.
+50 REM
+60 LET N% = 200000
+70 LET C% = 1
+80 LET L% = 2
+90 FOR P% = 3 TO N% STEP 2
+100 LET D% = 3
+110 IF D% * D% > P% THEN 160
+120 LET Q% = P% / D%
+130 IF Q% * D% = P% THEN 170
+140 LET D% = D% + 2
+150 GOTO 110
+160 LET C% = C% + 1
+165 LET L% = P%
+170 NEXT P%
+180 PRINT "PRIMES BELOW "; N%; ": "; C%
+190 PRINT "LARGEST: "; L%
@@ -0,0 +1,46 @@
+10 REM
+20 REM A STATE MACHINE DRIVEN BY A PSEUDO RANDOM SEQUENCE, DISPATCHED
+30 REM WITH A CHAIN OF IF/GOTO
+40 REM
+50 LET X% = 12345
+60 LET S% = 0
+70 LET A% = 0
+80 LET B% = 0
+90 LET C% = 0
+100 LET D% = 0
+110 FOR I% = 1 TO 400000
+120 LET X% = X% * 1103 + 12345
+125 LET Q% = X% / 65536
+130 LET X% = X% - Q% * 65536
+135 LET R% = X% / 256
+137 LET Q% = R% / 4
+140 LET R% = R% - Q% * 4
+150 IF S% = 0 THEN 300
+160 IF S% = 1 THEN 400
+170 IF S% = 2 THEN 500
+180 IF S% = 3 THEN 600
+190 PRINT "BAD STATE "; S%
+200 GOTO 900
+300 LET A% = A% + 1
+310 IF R% = 0 THEN 700
+320 LET S% = 1
+330 GOTO 700
+400 LET B% = B% + 1
+410 IF R% < 2 THEN 440
+420 LET S% = 2
+430 GOTO 700
+440 LET S% = 0
+450 GOTO 700
+500 LET C% = C% + 1
+510 IF R% = 3 THEN 540
+520 LET S% = 3
+530 GOTO 700
+540 LET S% = 1
+550 GOTO 700
+600 LET D% = D% + 1
+605 LET Q% = R% / 2
+610 LET S% = R% - Q% * 2
+700 NEXT I%
+800 PRINT "A "; A%; " B "; B%; " C "; C%; " D "; D%
+810 PRINT "FINAL STATE "; S%; " SEED "; X%
+900 REM
@@ -0,0 +1,15 @@
+10 REM
+20 REM STRING BUILDING: APPENDS, CONCATENATION AND COMPARISON
+30 REM
+40 LET C% = 0
+50 FOR I = 1 TO 30000
+60 LET A$ = ""
+70 FOR J = 1 TO 20
+80 LET A$ = A$ + "AB"
+90 LET B$ = "<" + A$ + ">"
+100 NEXT J
+110 IF A$ + "Z" < B$ THEN 130
+120 LET C% = C% + 1
+130 NEXT I
+140 PRINT B$
+150 PRINT "COUNT: "; C%
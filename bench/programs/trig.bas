@@ -0,0 +1,15 @@
+10 REM
+20 REM TRIG AND LOG HEAVY MATH
+30 REM
+40 LET S = 0
+50 LET C = 0
+60 LET L = 0
+70 FOR I = 1 TO 600000
+80 LET X = I / 1000
+90 LET S = S + SIN(X) * COS(X)
+100 LET C = C + TAN(X / 100)
+110 LET L = L + LN(X) - LOG(X)
+120 NEXT I
+130 PRINT "S = "; S
+140 PRINT "C = "; C
+150 PRINT "L = "; L
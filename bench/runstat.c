@@ -0,0 +1,45 @@
+#include <stdio.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/* runstat program args...
+ *
+ * Runs a program and then prints its wall time in seconds and peak RSS
+ * in KB as the last line of stderr. Linux carries the peak RSS of the
+ * process which execs a program over into it, so the benchmark script
+ * can't measure the interpreter directly; this is small enough not to
+ * skew the result.
+ */
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: runstat program args...\n");
+        return 1;
+    }
+    
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    
+    pid_t pid = fork();
+    if (pid == 0) {
+        execv(argv[1], &argv[1]);
+        perror(argv[1]);
+        _exit(127);
+    }
+    
+    int status;
+    struct rusage usage;
+    if (pid < 0 || wait4(pid, &status, 0, &usage) < 0) {
+        perror("runstat");
+        return 1;
+    }
+    
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    
+    double wall = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    fprintf(stderr, "runstat %.6f %ld\n", wall, usage.ru_maxrss);
+    
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}